@@ -1,9 +1,18 @@
 #include "../internal.h"
 #include "../gb.h"
 #include "apu.h"
+#include "../tables/blip_table.h"
 
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define APU_MIX_SSE2 1
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define APU_MIX_NEON 1
+#endif
+
 
 const bool SQUARE_DUTY_CYCLES[4][8] =
 {
@@ -26,44 +35,15 @@ static FORCE_INLINE uint8_t volume_right(const struct GB_Core* gb)
     return (IO_NR50 >> 0) & 0x7;
 }
 
-static FORCE_INLINE bool ch1_left_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 4) & 0x1;
-}
-
-static FORCE_INLINE bool ch2_left_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 5) & 0x1;
-}
-
-static FORCE_INLINE bool ch3_left_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 6) & 0x1;
-}
-
-static FORCE_INLINE bool ch4_left_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 7) & 0x1;
-}
-
-static FORCE_INLINE bool ch1_right_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 0) & 0x1;
-}
-
-static FORCE_INLINE bool ch2_right_output(const struct GB_Core* gb)
+// ch is 0-3
+static FORCE_INLINE bool left_output(const struct GB_Core* gb, const uint8_t ch)
 {
-    return (IO_NR51 >> 1) & 0x1;
+    return (IO_NR51 >> (4 + ch)) & 0x1;
 }
 
-static FORCE_INLINE bool ch3_right_output(const struct GB_Core* gb)
+static FORCE_INLINE bool right_output(const struct GB_Core* gb, const uint8_t ch)
 {
-    return (IO_NR51 >> 2) & 0x1;
-}
-
-static FORCE_INLINE bool ch4_right_output(const struct GB_Core* gb)
-{
-    return (IO_NR51 >> 3) & 0x1;
+    return (IO_NR51 >> (0 + ch)) & 0x1;
 }
 
 static FORCE_INLINE void clock_len(struct GB_Core* gb)
@@ -155,6 +135,8 @@ bool is_next_frame_sequencer_step_vol(const struct GB_Core* gb)
 // this is clocked by DIV
 void step_frame_sequencer(struct GB_Core* gb)
 {
+    GB_apu_sync(gb);
+
     if (!gb_is_apu_enabled(gb))
     {
         return;
@@ -181,178 +163,435 @@ void step_frame_sequencer(struct GB_Core* gb)
     gb->apu.frame_sequencer_counter = (gb->apu.frame_sequencer_counter + 1) % 8;
 }
 
-struct MixerSampleData
+enum { APU_BUFFER_MASK = GB_APU_BUFFER_FRAMES - 1 };
+
+// bit of a hack for FFA as the game uses very high frequency
+// to silence a channel (as it would be in audable).
+// the output is band-limited so this wouldn't alias anymore, however
+// it still saves adding a delta every few cycles.
+enum { MIN_AUDIBLE_PERIOD = 8 };  // minimum for FFA
+
+static void flush_apu_buffer(struct GB_Core* gb)
+{
+    struct GB_ApuBuffer* buf = &gb->apu_buffer;
+
+    const uint32_t frames = buf->write - buf->read;
+    const uint32_t start = buf->read & APU_BUFFER_MASK;
+    const uint32_t first = MIN(frames, GB_APU_BUFFER_FRAMES - start);
+
+    gb->callback.apu_block(gb->callback.user_apu_block, &buf->samples[start * 2], first);
+
+    // only happens if the frontend also pulled samples, wrapping the buffer
+    if (frames > first)
+    {
+        gb->callback.apu_block(gb->callback.user_apu_block, buf->samples, frames - first);
+    }
+
+    // reset so that the next block is contiguous
+    buf->read = buf->write = 0;
+}
+
+static FORCE_INLINE int16_t clamp_sample(const int32_t v)
 {
-    uint8_t sample;
-    bool left;
-    bool right;
-};
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
 
-struct MixerData
+// converts the integrated blip output to int16 with the master gain.
+// [count] is the number of samples (frames * 2).
+// the output is >> 9 (see read_blip) then * gain >> 8, saturated.
+static void mix_block(int16_t* dst, const int32_t* src, uint32_t count, const int32_t gain)
 {
-    struct MixerSampleData ch1;
-    struct MixerSampleData ch2;
-    struct MixerSampleData ch3;
-    struct MixerSampleData ch4;
+    uint32_t i = 0;
 
-    uint8_t left_amp, right_amp;
-};
+#if APU_MIX_SSE2
+    // sse2 has no 32-bit mullo, however the sample fits in 16-bits
+    // once shifted, so pack first then multiply as 16-bit, unpacking
+    // the hi / lo halves of the result back into 32-bit.
+    const __m128i vgain = _mm_set1_epi16((int16_t)gain);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const void*)(src + i + 0)), 9);
+        const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const void*)(src + i + 4)), 9);
+        const __m128i x = _mm_packs_epi32(a, b);
+
+        const __m128i lo = _mm_mullo_epi16(x, vgain);
+        const __m128i hi = _mm_mulhi_epi16(x, vgain);
+        const __m128i ra = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 8);
+        const __m128i rb = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 8);
+
+        _mm_storeu_si128((void*)(dst + i), _mm_packs_epi32(ra, rb));
+    }
+#elif APU_MIX_NEON
+    for (; i + 8 <= count; i += 8)
+    {
+        const int32x4_t a = vshrq_n_s32(vld1q_s32(src + i + 0), 9);
+        const int32x4_t b = vshrq_n_s32(vld1q_s32(src + i + 4), 9);
+        // saturate to 16-bit first, same as the sse2 path
+        const int16x8_t x = vcombine_s16(vqmovn_s32(a), vqmovn_s32(b));
+
+        const int32x4_t ra = vshrq_n_s32(vmull_n_s16(vget_low_s16(x), (int16_t)gain), 8);
+        const int32x4_t rb = vshrq_n_s32(vmull_n_s16(vget_high_s16(x), (int16_t)gain), 8);
+
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(ra), vqmovn_s32(rb)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        dst[i] = clamp_sample((clamp_sample(src[i] >> 9) * gain) >> 8);
+    }
+}
 
-static FORCE_INLINE struct GB_ApuCallbackData mixer(const struct GB_Core* gb, const struct MixerData* data)
+// writes the block to the sample buffer, flushing to the callback
+// every [block_frames].
+static void push_frames(struct GB_Core* gb, const int32_t* src, uint32_t frames)
 {
-    // bit of a hack for FFA as the game uses very high frequency
-    // to silence a channel (as it would be in audable)
-    // this causes terrible aliasing, so we check if the freq is too high
-    enum { LEFT, RIGHT };
-    enum { MAX_SAMPLE_RATE = 8 };  // minimum for FFA
+    struct GB_ApuBuffer* buf = &gb->apu_buffer;
+    const int32_t gain = gb->callback.apu_data.gain;
+    const uint32_t block_frames = gb->callback.apu_data.block_frames;
 
-    const uint16_t ch1_freq = get_ch1_freq(gb);
-    const uint16_t ch2_freq = get_ch2_freq(gb);
-    const uint16_t ch3_freq = get_ch3_freq(gb);
-    const uint32_t ch4_freq = get_ch4_freq(gb);
+    while (frames)
+    {
+        const uint32_t start = buf->write & APU_BUFFER_MASK;
+        uint32_t count = MIN(frames, GB_APU_BUFFER_FRAMES - start);
+
+        if (gb->callback.apu_block != NULL)
+        {
+            count = MIN(count, block_frames - (buf->write - buf->read));
+        }
+
+        mix_block(&buf->samples[start * 2], src, count * 2, gain);
+        buf->write += count;
+
+        // if full, drop the oldest frames as the frontend isn't keeping up
+        if (UNLIKELY(buf->write - buf->read > GB_APU_BUFFER_FRAMES))
+        {
+            buf->read = buf->write - GB_APU_BUFFER_FRAMES;
+        }
+
+        if (gb->callback.apu_block != NULL && buf->write - buf->read >= block_frames)
+        {
+            flush_apu_buffer(gb);
+        }
+
+        src += count * 2;
+        frames -= count;
+    }
+}
+
+static FORCE_INLINE void blip_add_delta(struct GB_ApuBlip* blip, const uint64_t factor, const enum GB_ApuResampler resampler, const uint8_t side, const uint32_t time, const int32_t delta)
+{
+    const uint64_t pos = blip->offset + time * factor;
+    int32_t* out = &blip->buf[side][pos >> 32];
+
+    if (resampler == GB_APU_RESAMPLER_LINEAR)
+    {
+        // split the step between the 2 samples either side of it.
+        // this uses the same centre tap as the sinc table so that the
+        // delay is the same for both.
+        enum { CENTRE = GB_APU_BLIP_TAPS / 2 - 1 };
+        const int32_t frac = (pos >> 17) & 0x7FFF;
+
+        out[CENTRE + 0] += ((1 << 15) - frac) * delta;
+        out[CENTRE + 1] += frac * delta;
+        return;
+    }
+
+    // the top 6 bits of the fraction select the phase
+    const int16_t* step = BLIP_STEP_TABLE[(pos >> 26) & 63];
+
+    for (uint8_t i = 0; i < GB_APU_BLIP_TAPS; ++i)
+    {
+        out[i] += step[i] * delta;
+    }
+}
+
+// sets the new output level of the channel, adding the delta if changed.
+// sample is the channel's volume (0-15) at [time] cycles into the sync.
+static FORCE_INLINE void set_channel_level(struct GB_Core* gb, const uint8_t ch, const uint8_t sample, const uint32_t time)
+{
+    struct GB_ApuBlip* blip = &gb->apu_blip;
+    const uint64_t factor = gb->callback.apu_data.factor;
+    const enum GB_ApuResampler resampler = gb->callback.apu_data.resampler;
+
+    const uint8_t left = sample * left_output(gb, ch) * (volume_left(gb) + 1);
+    const uint8_t right = sample * right_output(gb, ch) * (volume_right(gb) + 1);
+
+    if (left != blip->level[ch][0])
+    {
+        blip_add_delta(blip, factor, resampler, 0, time, left - blip->level[ch][0]);
+        blip->level[ch][0] = left;
+    }
 
-    const bool ch1_audible = ch1_freq >= MAX_SAMPLE_RATE;
-    const bool ch2_audible = ch2_freq >= MAX_SAMPLE_RATE;
-    const bool ch3_audible = ch3_freq >= MAX_SAMPLE_RATE;
-    const bool ch4_audible = ch4_freq >= MAX_SAMPLE_RATE;
+    if (right != blip->level[ch][1])
+    {
+        blip_add_delta(blip, factor, resampler, 1, time, right - blip->level[ch][1]);
+        blip->level[ch][1] = right;
+    }
+}
+
+// returns how many times a channel is clocked in [cycles], updating the timer.
+// this is the same as the loops in run_channels() but without the stepping.
+static FORCE_INLINE uint32_t skip_timer(int32_t* timer, const uint32_t freq, const uint32_t cycles)
+{
+    if (UNLIKELY(freq == 0))
+    {
+        return 0;
+    }
 
-    return (struct GB_ApuCallbackData)
+    if (*timer > (int32_t)cycles)
     {
-        .ch1[LEFT]  = data->ch1.sample * data->ch1.left  * data->left_amp  * ch1_audible,
-        .ch1[RIGHT] = data->ch1.sample * data->ch1.right * data->right_amp * ch1_audible,
-        .ch2[LEFT]  = data->ch2.sample * data->ch2.left  * data->left_amp  * ch2_audible,
-        .ch2[RIGHT] = data->ch2.sample * data->ch2.right * data->right_amp * ch2_audible,
-        .ch3[LEFT]  = data->ch3.sample * data->ch3.left  * data->left_amp  * ch3_audible,
-        .ch3[RIGHT] = data->ch3.sample * data->ch3.right * data->right_amp * ch3_audible,
-        .ch4[LEFT]  = data->ch4.sample * data->ch4.left  * data->left_amp  * ch4_audible,
-        .ch4[RIGHT] = data->ch4.sample * data->ch4.right * data->right_amp * ch4_audible,
-    };
+        *timer -= cycles;
+        return 0;
+    }
+
+    const uint32_t clocks = 1 + (uint32_t)((int32_t)cycles - *timer) / freq;
+    *timer += clocks * freq - cycles;
+    return clocks;
 }
 
-static FORCE_INLINE void sample_channels(struct GB_Core* gb)
+// used when there's no audio output (freq is 0).
+// nothing is synthesised, only the state that the game can see is kept.
+// the duty and position counters are still advanced, so that wave ram reads
+// work and the output is the same if audio is enabled again.
+// the ch4 lfsr is also clocked, so muting doesn't change the core state.
+static void skip_channels(struct GB_Core* gb, const uint32_t cycles)
 {
-    // build up data for the mixer!
-    struct GB_ApuCallbackData samples = {0};
+    if (UNLIKELY(!gb_is_apu_enabled(gb)))
+    {
+        return;
+    }
+
+    if (is_ch1_enabled(gb))
+    {
+        int32_t timer = CH1.timer;
+        CH1.duty_index = (CH1.duty_index + skip_timer(&timer, get_ch1_freq(gb), cycles)) % 8;
+        CH1.timer = timer;
+    }
+
+    if (is_ch2_enabled(gb))
+    {
+        int32_t timer = CH2.timer;
+        CH2.duty_index = (CH2.duty_index + skip_timer(&timer, get_ch2_freq(gb), cycles)) % 8;
+        CH2.timer = timer;
+    }
 
-    if (gb_is_apu_enabled(gb))
+    if (is_ch3_enabled(gb))
     {
-        // build up data for the mixer!
-        const struct MixerData mixer_data =
+        int32_t timer = CH3.timer;
+        const uint32_t clocks = skip_timer(&timer, get_ch3_freq(gb), cycles);
+        CH3.timer = timer;
+
+        if (clocks)
         {
-            .ch1 =
-            {
-                .sample = sample_ch1(gb),
-                .left = ch1_left_output(gb),
-                .right = ch1_right_output(gb)
-            },
-            .ch2 =
-            {
-                .sample = sample_ch2(gb),
-                .left = ch2_left_output(gb),
-                .right = ch2_right_output(gb)
-            },
-            .ch3 =
-            {
-                .sample = sample_ch3(gb),
-                .left = ch3_left_output(gb),
-                .right = ch3_right_output(gb)
-            },
-            .ch4 =
-            {
-                .sample = sample_ch4(gb),
-                .left = ch4_left_output(gb),
-                .right = ch4_right_output(gb)
-            },
-            .left_amp = volume_left(gb) + 1,
-            .right_amp = volume_right(gb) + 1,
-        };
-
-        samples = mixer(gb, &mixer_data);
+            CH3.position_counter = (CH3.position_counter + clocks) % 32;
+            CH3.sample_buffer = IO_WAVE_TABLE[CH3.position_counter >> 1];
+        }
     }
 
-    if (LIKELY(gb->callback.apu != NULL))
+    if (is_ch4_enabled(gb) && IO_NR43.clock_shift != 14 && IO_NR43.clock_shift != 15)
     {
-        gb->callback.apu(gb->callback.user_apu, &samples);
+        int32_t timer = CH4.timer;
+        const uint32_t clocks = skip_timer(&timer, get_ch4_freq(gb), cycles);
+        CH4.timer = timer;
+
+        for (uint32_t i = 0; i < clocks; ++i)
+        {
+            step_ch4_lfsr(gb);
+        }
     }
 }
 
-void GB_apu_run(struct GB_Core* gb, uint16_t cycles)
+static void run_channels(struct GB_Core* gb, const uint32_t cycles)
 {
-    if (LIKELY(gb_is_apu_enabled(gb)))
+    if (UNLIKELY(!gb_is_apu_enabled(gb)))
+    {
+        for (uint8_t ch = 0; ch < 4; ++ch)
+        {
+            set_channel_level(gb, ch, 0, 0);
+        }
+        return;
+    }
+
+    const uint16_t ch1_freq = get_ch1_freq(gb);
+    const uint16_t ch2_freq = get_ch2_freq(gb);
+    const uint16_t ch3_freq = get_ch3_freq(gb);
+    const uint32_t ch4_freq = get_ch4_freq(gb);
+
+    const bool ch1_audible = ch1_freq >= MIN_AUDIBLE_PERIOD;
+    const bool ch2_audible = ch2_freq >= MIN_AUDIBLE_PERIOD;
+    const bool ch3_audible = ch3_freq >= MIN_AUDIBLE_PERIOD;
+    const bool ch4_audible = ch4_freq >= MIN_AUDIBLE_PERIOD;
+
+    // registers may have changed since the last sync, so update the
+    // levels first, this is at time 0 as that's when the write happened.
+    set_channel_level(gb, 0, sample_ch1(gb) * ch1_audible, 0);
+    set_channel_level(gb, 1, sample_ch2(gb) * ch2_audible, 0);
+    set_channel_level(gb, 2, sample_ch3(gb) * ch3_audible, 0);
+    set_channel_level(gb, 3, sample_ch4(gb) * ch4_audible, 0);
+
+    // each timer is the number of cycles until the channel is next
+    // clocked, so step through each clock in this batch.
+    // im going to guess that the channels are only clocked if they're enabled
+    if (is_ch1_enabled(gb) && LIKELY((CH1.timer > 0 || ch1_freq)))
     {
-        // im going to guess that the channels are only clocked if they're enabled
-        if (is_ch1_enabled(gb))
+        int32_t timer = CH1.timer;
+
+        while (timer <= (int32_t)cycles)
         {
-            const uint16_t ch1_freq = get_ch1_freq(gb);
-
-            if (LIKELY((CH1.timer > 0 || ch1_freq)))
-            {
-                CH1.timer -= cycles;
-                while (CH1.timer <= 0)
-                {
-                    CH1.timer += ch1_freq;
-                    CH1.duty_index = (CH1.duty_index + 1) % 8;
-                }
-            }
+            CH1.duty_index = (CH1.duty_index + 1) % 8;
+            set_channel_level(gb, 0, sample_ch1(gb) * ch1_audible, MAX(timer, 0));
+            timer += ch1_freq;
         }
 
-        if (is_ch2_enabled(gb))
+        CH1.timer = timer - cycles;
+    }
+
+    if (is_ch2_enabled(gb) && LIKELY((CH2.timer > 0 || ch2_freq)))
+    {
+        int32_t timer = CH2.timer;
+
+        while (timer <= (int32_t)cycles)
         {
-            const uint16_t ch2_freq = get_ch2_freq(gb);
-
-            if (LIKELY((CH2.timer > 0 || ch2_freq)))
-            {
-                CH2.timer -= cycles;
-                while (CH2.timer <= 0)
-                {
-                    CH2.timer += ch2_freq;
-                    CH2.duty_index = (CH2.duty_index + 1) % 8;
-                }
-            }
+            CH2.duty_index = (CH2.duty_index + 1) % 8;
+            set_channel_level(gb, 1, sample_ch2(gb) * ch2_audible, MAX(timer, 0));
+            timer += ch2_freq;
         }
 
-        if (is_ch3_enabled(gb))
+        CH2.timer = timer - cycles;
+    }
+
+    if (is_ch3_enabled(gb) && LIKELY((CH3.timer > 0 || ch3_freq)))
+    {
+        int32_t timer = CH3.timer;
+
+        while (timer <= (int32_t)cycles)
         {
-            const uint16_t ch3_freq = get_ch3_freq(gb);
-
-            if (LIKELY((CH3.timer > 0 || ch3_freq)))
-            {
-                CH3.timer -= cycles;
-                while (CH3.timer <= 0)
-                {
-                    CH3.timer += ch3_freq;
-                    advance_ch3_position_counter(gb);
-                }
-            }
+            advance_ch3_position_counter(gb);
+            set_channel_level(gb, 2, sample_ch3(gb) * ch3_audible, MAX(timer, 0));
+            timer += ch3_freq;
         }
 
-        // NOTE: ch4 lfsr is ONLY clocked if clock shift is not 14 or 15
-        if (is_ch4_enabled(gb) && IO_NR43.clock_shift != 14 && IO_NR43.clock_shift != 15)
+        CH3.timer = timer - cycles;
+    }
+
+    // NOTE: ch4 lfsr is ONLY clocked if clock shift is not 14 or 15
+    if (is_ch4_enabled(gb) && IO_NR43.clock_shift != 14 && IO_NR43.clock_shift != 15 && LIKELY((CH4.timer > 0 || ch4_freq)))
+    {
+        int32_t timer = CH4.timer;
+
+        while (timer <= (int32_t)cycles)
         {
-            const uint32_t ch4_freq = get_ch4_freq(gb);
-
-            if (LIKELY((CH4.timer > 0 || ch4_freq)))
-            {
-                CH4.timer -= cycles;
-                while (CH4.timer <= 0)
-                {
-                    CH4.timer += ch4_freq;
-                    step_ch4_lfsr(gb);
-                }
-            }
+            step_ch4_lfsr(gb);
+            set_channel_level(gb, 3, sample_ch4(gb) * ch4_audible, MAX(timer, 0));
+            timer += ch4_freq;
         }
+
+        CH4.timer = timer - cycles;
+    }
+}
+
+// reads out all the samples that no future delta can touch.
+static void read_blip(struct GB_Core* gb, const uint32_t cycles)
+{
+    struct GB_ApuBlip* blip = &gb->apu_blip;
+
+    blip->offset += cycles * gb->callback.apu_data.factor;
+
+    const uint32_t avail = blip->offset >> 32;
+
+    if (avail == 0)
+    {
+        return;
+    }
+
+    // one sync is at most GB_APU_BLIP_SIZE / 2 frames
+    int32_t block[GB_APU_BLIP_SIZE * 2];
+    const uint8_t hpf_shift = gb->callback.apu_data.hpf_shift;
+
+    int32_t left = blip->integrator[0];
+    int32_t right = blip->integrator[1];
+
+    for (uint32_t i = 0; i < avail; ++i)
+    {
+        left += blip->buf[0][i];
+        right += blip->buf[1][i];
+
+        // the step table is scaled by 1 << 15, each channel is 0-120
+        // so the sum is 0-480, mix_block() >> 9 scales that to 0-30720.
+        block[i * 2 + 0] = left;
+        block[i * 2 + 1] = right;
+
+        // dc blocking high-pass, the integrator slowly leaks back to 0.
+        left -= left >> hpf_shift;
+        right -= right >> hpf_shift;
     }
 
-    // we should still sample even if the apu is disabled
-    // in this case, the samples are filled with 0.
-    if (LIKELY(gb->callback.apu_data.freq_reload))
+    push_frames(gb, block, avail);
+
+    blip->integrator[0] = left;
+    blip->integrator[1] = right;
+
+    // move the tail of the steps that are still in progress to the start
+    for (uint8_t side = 0; side < 2; ++side)
+    {
+        memmove(blip->buf[side], blip->buf[side] + avail, GB_APU_BLIP_TAPS * sizeof(int32_t));
+        memset(blip->buf[side] + GB_APU_BLIP_TAPS, 0, avail * sizeof(int32_t));
+    }
+
+    blip->offset -= (uint64_t)avail << 32;
+}
+
+void GB_apu_sync(struct GB_Core* gb)
+{
+    while (gb->apu.pending_cycles)
     {
-        gb->apu.next_sample_cycles += cycles;
+        const uint32_t cycles = MIN(gb->apu.pending_cycles, gb->callback.apu_data.sync_cycles);
 
-        while (gb->apu.next_sample_cycles >= gb->callback.apu_data.freq_reload)
+        if (gb->callback.apu_data.factor)
+        {
+            run_channels(gb, cycles);
+            read_blip(gb, cycles);
+        }
+        else
         {
-            gb->apu.next_sample_cycles -= (uint16_t)gb->callback.apu_data.freq_reload;
-            sample_channels(gb);
+            skip_channels(gb, cycles);
         }
+
+        gb->apu.pending_cycles -= cycles;
+    }
+}
+
+uint32_t GB_get_apu_samples_available(const struct GB_Core* gb)
+{
+    return gb->apu_buffer.write - gb->apu_buffer.read;
+}
+
+uint32_t GB_read_apu_samples(struct GB_Core* gb, int16_t* samples, uint32_t frames)
+{
+    struct GB_ApuBuffer* buf = &gb->apu_buffer;
+
+    frames = MIN(frames, buf->write - buf->read);
+
+    const uint32_t start = buf->read & APU_BUFFER_MASK;
+    const uint32_t first = MIN(frames, GB_APU_BUFFER_FRAMES - start);
+
+    memcpy(samples, &buf->samples[start * 2], first * 2 * sizeof(int16_t));
+    memcpy(samples + first * 2, buf->samples, (frames - first) * 2 * sizeof(int16_t));
+
+    buf->read += frames;
+
+    return frames;
+}
+
+void GB_apu_run(struct GB_Core* gb, uint16_t cycles)
+{
+    // the channels are run in batches, see GB_apu_sync()
+    gb->apu.pending_cycles += cycles;
+
+    if (gb->apu.pending_cycles >= gb->callback.apu_data.sync_cycles)
+    {
+        GB_apu_sync(gb);
     }
 }
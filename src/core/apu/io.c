@@ -7,6 +7,9 @@
 
 void GB_apu_iowrite(struct GB_Core* gb, uint16_t addr, uint8_t value)
 {
+    // the apu is run in batches, so catch it up before writing
+    GB_apu_sync(gb);
+
     addr &= 0x3F;
 
     // on // off reg is always writable
@@ -114,10 +114,16 @@ static FORCE_INLINE void GB_iowrite_gbc(struct GB_Core* gb, uint16_t addr, uint8
 
 // void (*gb_audio_callback)(uint8_t volume, enum GB_AudioChannel channel);
 
-static inline uint8_t GB_ioread(const struct GB_Core* gb, uint16_t addr)
+static inline uint8_t GB_ioread(struct GB_Core* gb, uint16_t addr)
 {
     addr &= 0x7F;
 
+    // the apu is run in batches, so catch it up before reading
+    if (addr >= 0x10 && addr <= 0x3F)
+    {
+        GB_apu_sync(gb);
+    }
+
     // if apu and ch3 are enabled, then wave ram returns 0xFF
     // or the value at sample index
     if (addr >= 0x30 && addr <= 0x3F && is_ch3_enabled(gb))
@@ -199,10 +205,12 @@ static inline void GB_iowrite(struct GB_Core* gb, uint16_t addr, uint8_t value)
             break;
 
         case 0x42:
+            DMG_log_reg_write(gb, 0x42, value);
             IO_SCY = value;
             break;
 
         case 0x43:
+            DMG_log_reg_write(gb, 0x43, value);
             IO_SCX = value;
             break;
 
@@ -233,6 +241,7 @@ static inline void GB_iowrite(struct GB_Core* gb, uint16_t addr, uint8_t value)
             break;
 
         case 0x4B:
+            DMG_log_reg_write(gb, 0x4B, value);
             IO_WX = value;
             break;
 
@@ -271,6 +280,7 @@ void GB_ffwrite8(struct GB_Core* gb, uint8_t addr, uint8_t value)
     else
     {
         gb->mem.hram[addr & 0x7F] = value;
+        GB_mark_page_dirty(gb, GB_PAGE_HRAM);
     }
 }
 
@@ -352,15 +362,18 @@ void GB_write8(struct GB_Core* gb, uint16_t addr, uint8_t value)
                 if (is_vram_writeable(gb))
                 {
                     gb->ppu.vram[gb->mem.vbk][addr & 0x1FFF] = value;
+                    GB_mark_page_dirty(gb, GB_PAGE_VRAM + gb->mem.vbk * 0x20 + ((addr >> 8) & 0x1F));
                 }
                 break;
 
             case 0xC: case 0xE:
                 gb->mem.wram[0][addr & 0x0FFF] = value;
+                GB_mark_page_dirty(gb, GB_PAGE_WRAM + ((addr >> 8) & 0xF));
                 break;
 
             case 0xD: case 0xF:
                 gb->mem.wram[gb->mem.svbk][addr & 0x0FFF] = value;
+                GB_mark_page_dirty(gb, GB_PAGE_WRAM + gb->mem.svbk * 0x10 + ((addr >> 8) & 0xF));
                 break;
         }
     }
@@ -373,6 +386,7 @@ void GB_write8(struct GB_Core* gb, uint16_t addr, uint8_t value)
                 if (is_oam_writeable(gb))
                 {
                     gb->ppu.oam[addr & 0xFF] = value;
+                    GB_mark_page_dirty(gb, GB_PAGE_OAM);
                 }
                 break;
 
@@ -384,6 +398,7 @@ void GB_write8(struct GB_Core* gb, uint16_t addr, uint8_t value)
             case 0x18: case 0x19: case 0x1A: case 0x1B:
             case 0x1C: case 0x1D: case 0x1E: case 0x1F:
                 gb->mem.hram[addr & 0x7F] = value;
+                GB_mark_page_dirty(gb, GB_PAGE_HRAM);
                 break;
         }
     }
@@ -468,6 +483,8 @@ void GB_update_wram_banks(struct GB_Core* gb)
 
 void GB_setup_mmap(struct GB_Core* gb)
 {
+    // the cart may have been replaced by a state or clone
+    GB_setup_mbc_ops(gb);
     GB_update_rom_banks(gb);
     GB_update_ram_banks(gb);
     GB_update_vram_banks(gb);
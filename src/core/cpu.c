@@ -395,6 +395,7 @@ static void sprite_ram_bug(struct GB_Core* gb, uint8_t v)
         if (GB_get_status_mode(gb) == 2)
         {
             memset(gb->ppu.oam + 0x4, 0xFF, sizeof(gb->ppu.oam) - 0x4);
+            GB_mark_page_dirty(gb, GB_PAGE_OAM);
             GB_log("INC_HL oam corrupt bug!\n");
         }
     }
@@ -25,6 +25,12 @@ bool GB_init(struct GB_Core* gb)
 
     memset(gb, 0, sizeof(struct GB_Core));
 
+    // sets up the default apu batch size
+    gb->callback.apu_data.ratio = GB_APU_RATIO_ONE;
+    gb->callback.apu_data.gain = GB_APU_GAIN_ONE;
+    GB_set_apu_freq(gb, 0);
+    GB_setup_mbc_ops(gb);
+
     return true;
 }
 
@@ -44,6 +50,12 @@ void GB_reset(struct GB_Core* gb)
     memset(&gb->joypad, 0, sizeof(gb->joypad));
     memset(IO, 0xFF, sizeof(IO));
 
+    GB_clear_input_queue(gb);
+    GB_mark_all_pages_dirty(gb);
+
+    gb->apu_buffer.read = gb->apu_buffer.write = 0;
+    memset(&gb->apu_blip, 0, sizeof(gb->apu_blip));
+
     GB_update_all_colours_gb(gb);
 
     gb->joypad.var = 0xFF;
@@ -325,6 +337,17 @@ bool GB_set_rtc(struct GB_Core* gb, const struct GB_Rtc rtc)
     return true;
 }
 
+bool GB_get_rtc(const struct GB_Core* gb, struct GB_Rtc* rtc)
+{
+    if (GB_has_mbc_flags(gb, MBC_FLAGS_RTC) == false)
+    {
+        return false;
+    }
+
+    *rtc = gb->cart.rtc;
+    return true;
+}
+
 bool GB_has_mbc_flags(const struct GB_Core* gb, const uint8_t flags)
 {
     return (gb->cart.flags & flags) == flags;
@@ -443,6 +466,16 @@ void GB_set_sram(struct GB_Core* gb, uint8_t* ram, size_t size)
     }
 }
 
+bool GB_is_sram_dirty(const struct GB_Core* gb)
+{
+    return gb->ram_dirty;
+}
+
+void GB_clear_sram_dirty(struct GB_Core* gb)
+{
+    gb->ram_dirty = false;
+}
+
 bool GB_get_rom_info(const uint8_t* data, size_t size, struct GB_RomInfo* info_out)
 {
     // todo: should ensure the romsize is okay!
@@ -465,13 +498,19 @@ bool GB_get_rom_info(const uint8_t* data, size_t size, struct GB_RomInfo* info_o
     return true;
 }
 
-bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size)
+static bool loadrom(struct GB_Core* gb, const uint8_t* data, size_t size, bool partial)
 {
     if (!data || !size)
     {
         return false;
     }
 
+    // a partial rom must at least have bank 0 and a callback for the rest.
+    if (partial && (size < 0x4000 || !gb->callback.rom_bank))
+    {
+        return false;
+    }
+
     if (size < GB_BOOTROM_SIZE + sizeof(struct GB_CartHeader))
     {
         return false;
@@ -488,7 +527,9 @@ bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size)
 
     gb->cart.rom_size = ROM_SIZE_MULT << header->rom_size;
 
-    if (gb->cart.rom_size > size)
+    // the rom bank callback provides the banks of a partial rom, so the data
+    // may be smaller, ie, a compressed rom where only bank 0 is stored as is.
+    if (gb->cart.rom_size > size && !partial)
     {
         return false;
     }
@@ -608,7 +649,8 @@ bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size)
 
     // todo: should add more checks before we get to this point!
     gb->rom = data;
-    gb->rom_size = size;
+    // only bank 0 of a partial rom is rom data, the rest isn't mapped.
+    gb->rom_size = partial ? 0x4000 : size;
 
     GB_reset(gb);
     GB_setup_mmap(gb);
@@ -622,6 +664,16 @@ bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size)
     return true;
 }
 
+bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size)
+{
+    return loadrom(gb, data, size, false);
+}
+
+bool GB_loadrom_partial(struct GB_Core* gb, const uint8_t* data, size_t size)
+{
+    return loadrom(gb, data, size, true);
+}
+
 bool GB_has_save(const struct GB_Core* gb)
 {
     return (gb->cart.flags & (MBC_FLAGS_RAM | MBC_FLAGS_BATTERY)) == (MBC_FLAGS_RAM | MBC_FLAGS_BATTERY);
@@ -641,7 +693,31 @@ size_t GB_calculate_savedata_size(const struct GB_Core* gb)
 enum { STATE_MAGIC = 0x6BCE };
 enum { STATE_VER = 1 };
 
-bool GB_savestate(const struct GB_Core* gb, struct GB_State* state)
+// the amount of sram that is saved in a state, 0 if none.
+static size_t get_state_sram_size(const struct GB_Core* gb)
+{
+    const size_t sram_size = GB_calculate_savedata_size(gb);
+
+    if (sram_size && sram_size <= gb->ram_size && gb->ram)
+    {
+        return sram_size;
+    }
+
+    return 0;
+}
+
+// only writes if changed, as the sram may be a mapped file, in which
+// case an identical copy would still dirty every page.
+static void load_sram(struct GB_Core* gb, const uint8_t* sram, size_t size)
+{
+    if (memcmp(gb->ram, sram, size))
+    {
+        memcpy(gb->ram, sram, size);
+        gb->ram_dirty = true;
+    }
+}
+
+bool GB_quicksave(const struct GB_Core* gb, struct GB_State* state)
 {
     if (!state || !gb->rom)
     {
@@ -665,12 +741,10 @@ bool GB_savestate(const struct GB_Core* gb, struct GB_State* state)
     memcpy(&state->cart, &gb->cart, sizeof(state->cart));
     memcpy(&state->timer, &gb->timer, sizeof(state->timer));
 
-    // set array to zero to allow for unused space to be better compressed
-    memset(state->sram, 0, sizeof(state->sram));
-
-    const size_t sram_size = GB_calculate_savedata_size(gb);
+    // only copy the sram the cart has, the rest of the array is left as is
+    const size_t sram_size = get_state_sram_size(gb);
 
-    if (sram_size && sram_size <= gb->ram_size && gb->ram)
+    if (sram_size)
     {
         memcpy(state->sram, gb->ram, sram_size);
     }
@@ -678,6 +752,21 @@ bool GB_savestate(const struct GB_Core* gb, struct GB_State* state)
     return true;
 }
 
+bool GB_savestate(const struct GB_Core* gb, struct GB_State* state)
+{
+    if (!GB_quicksave(gb, state))
+    {
+        return false;
+    }
+
+    // set the unused sram to zero to allow it to be better compressed
+    const size_t sram_size = get_state_sram_size(gb);
+
+    memset(state->sram + sram_size, 0, sizeof(state->sram) - sram_size);
+
+    return true;
+}
+
 bool GB_loadstate(struct GB_Core* gb, const struct GB_State* state)
 {
     if (!state || !gb->rom)
@@ -702,11 +791,574 @@ bool GB_loadstate(struct GB_Core* gb, const struct GB_State* state)
     memcpy(&gb->cart, &state->cart, sizeof(gb->cart));
     memcpy(&gb->timer, &state->timer, sizeof(gb->timer));
 
-    const size_t sram_size = GB_calculate_savedata_size(gb);
+    const size_t sram_size = get_state_sram_size(gb);
 
-    if (sram_size && sram_size <= gb->ram_size && gb->ram)
+    if (sram_size)
+    {
+        load_sram(gb, state->sram, sram_size);
+    }
+
+    // we need to reload mmaps
+    GB_setup_mmap(gb);
+    // reload colours!
+    GB_update_all_colours_gb(gb);
+    GB_mark_all_pages_dirty(gb);
+
+    return true;
+}
+
+bool GB_clone(struct GB_Core* dst, const struct GB_Core* src)
+{
+    if (!dst || !src || dst == src || !src->rom)
+    {
+        return false;
+    }
+
+    // the sram is copied into dst's own buffer, so it has to be big enough.
+    // it isn't shared as src could write to it (or free it) whilst dst
+    // is still reading from it, and it's at most 128KiB.
+    const size_t sram_size = get_state_sram_size(src);
+
+    if (sram_size && (!dst->ram || dst->ram_size < sram_size))
+    {
+        return false;
+    }
+
+    // banks from a callback (ie, zrom) are only valid for the rom that
+    // was loaded through it, so both must use the same callback and
+    // dst must have loaded the same rom.
+    if (dst->callback.rom_bank != src->callback.rom_bank || (src->callback.rom_bank && dst->rom != src->rom))
+    {
+        return false;
+    }
+
+    dst->cycles_left_to_run = src->cycles_left_to_run;
+    dst->mem = src->mem;
+    dst->cpu = src->cpu;
+    dst->ppu = src->ppu;
+    dst->apu = src->apu;
+    dst->cart = src->cart;
+    dst->timer = src->timer;
+    dst->joypad = src->joypad;
+    dst->input_queue = src->input_queue;
+    dst->palette = src->palette;
+    dst->system_type = src->system_type;
+    dst->config = src->config;
+    dst->apu_blip = src->apu_blip;
+
+    // the rom isn't owned by the core, so it's always shared
+    dst->rom = src->rom;
+    dst->rom_size = src->rom_size;
+
+    if (sram_size)
+    {
+        load_sram(dst, src->ram, sram_size);
+    }
+
+    // dst keeps its own samples, any pending in src are for src's frontend.
+    dst->apu_buffer.read = dst->apu_buffer.write = 0;
+
+    // the mmap points into src, the colours are copied with the ppu
+    // so they don't need to be rebuilt.
+    GB_setup_mmap(dst);
+    GB_mark_all_pages_dirty(dst);
+
+    return true;
+}
+
+// the compact state is a header followed by chunks, each chunk is
+// a 4 byte tag, a 4 byte size then the data.
+// chunks are only written if they exist on the current system / cart,
+// unknown chunks are skipped when loading.
+enum { COMPACT_STATE_MAGIC = 0x6BCF };
+enum { COMPACT_STATE_VER = 1 };
+
+#define STATE_TAG(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+
+enum StateChunkTag
+{
+    STATE_CHUNK_CPU = STATE_TAG('C', 'P', 'U', ' '),
+    STATE_CHUNK_MEM = STATE_TAG('M', 'E', 'M', ' '),
+    STATE_CHUNK_WRAM = STATE_TAG('W', 'R', 'A', 'M'),
+    STATE_CHUNK_PPU = STATE_TAG('P', 'P', 'U', ' '),
+    STATE_CHUNK_VRAM = STATE_TAG('V', 'R', 'A', 'M'),
+    STATE_CHUNK_APU = STATE_TAG('A', 'P', 'U', ' '),
+    STATE_CHUNK_CART = STATE_TAG('C', 'A', 'R', 'T'),
+    STATE_CHUNK_TIMER = STATE_TAG('T', 'I', 'M', 'R'),
+    STATE_CHUNK_SRAM = STATE_TAG('S', 'R', 'A', 'M'),
+    // list of {u16 page, page data}
+    STATE_CHUNK_PAGE = STATE_TAG('P', 'A', 'G', 'E'),
+    // the cycles GB_run() overshot by, optional.
+    // needed for a loaded state to run exactly the same as the original.
+    STATE_CHUNK_RUN = STATE_TAG('R', 'U', 'N', ' '),
+};
+
+struct CompactStateHeader
+{
+    uint16_t magic;
+    uint16_t version;
+    uint32_t size;
+    // the structs will have different sizes based on if built with sgb / gbc
+    uint8_t gbc_enabled;
+    uint8_t sgb_enabled;
+    // the wram / vram chunks depend on the system type
+    uint8_t system_type;
+    uint8_t flags;
+};
+
+enum CompactStateFlags
+{
+    // the memory chunks are replaced by a PAGE chunk, see
+    // GB_serialize_state_delta().
+    COMPACT_STATE_FLAG_DELTA = 1 << 0,
+};
+
+struct StateChunkHeader
+{
+    uint32_t tag;
+    uint32_t size;
+};
+
+// the mem and ppu chunks are the structs without the wram / vram,
+// those are split into their own chunks so only the used banks are saved.
+#define MEM_HEAD_SIZE offsetof(struct GB_mem, wram)
+#define MEM_TAIL_OFFSET (offsetof(struct GB_mem, wram) + sizeof(((struct GB_mem*)0)->wram))
+#define MEM_TAIL_SIZE (sizeof(struct GB_mem) - MEM_TAIL_OFFSET)
+#define PPU_HEAD_SIZE offsetof(struct GB_Ppu, vram)
+#define PPU_TAIL_OFFSET (offsetof(struct GB_Ppu, vram) + sizeof(((struct GB_Ppu*)0)->vram))
+#define PPU_TAIL_SIZE (sizeof(struct GB_Ppu) - PPU_TAIL_OFFSET)
+
+// dmg only has 2 banks of wram and 1 bank of vram
+static size_t get_state_wram_size(const struct GB_Core* gb)
+{
+#if GBC_ENABLE
+    if (GB_is_system_gbc(gb))
+    {
+        return sizeof(gb->mem.wram);
+    }
+#else
+    (void)gb;
+#endif
+    return 0x1000 * 2;
+}
+
+static size_t get_state_vram_size(const struct GB_Core* gb)
+{
+#if GBC_ENABLE
+    if (GB_is_system_gbc(gb))
+    {
+        return sizeof(gb->ppu.vram);
+    }
+#else
+    (void)gb;
+#endif
+    return 0x2000;
+}
+
+struct StateWriter
+{
+    uint8_t* data; // NULL if only calculating the size
+    size_t offset;
+};
+
+static void state_write(struct StateWriter* w, const void* src, size_t size)
+{
+    if (w->data)
+    {
+        memcpy(w->data + w->offset, src, size);
+    }
+
+    w->offset += size;
+}
+
+static void state_write_chunk(struct StateWriter* w, enum StateChunkTag tag, const void* src, size_t size)
+{
+    const struct StateChunkHeader header = { .tag = tag, .size = (uint32_t)size };
+
+    state_write(w, &header, sizeof(header));
+    state_write(w, src, size);
+}
+
+// same as above, but the data is split in 2 parts.
+static void state_write_split_chunk(struct StateWriter* w, enum StateChunkTag tag, const void* head, size_t head_size, const void* tail, size_t tail_size)
+{
+    const struct StateChunkHeader header = { .tag = tag, .size = (uint32_t)(head_size + tail_size) };
+
+    state_write(w, &header, sizeof(header));
+    state_write(w, head, head_size);
+    state_write(w, tail, tail_size);
+}
+
+// returns the size of the page, 0 if it doesn't exist on this system / cart.
+static size_t get_page_size(const struct GB_Core* gb, uint16_t page)
+{
+    if (page < GB_PAGE_VRAM)
+    {
+        return (size_t)(page - GB_PAGE_WRAM) * GB_PAGE_SIZE < get_state_wram_size(gb) ? GB_PAGE_SIZE : 0;
+    }
+    else if (page < GB_PAGE_OAM)
+    {
+        return (size_t)(page - GB_PAGE_VRAM) * GB_PAGE_SIZE < get_state_vram_size(gb) ? GB_PAGE_SIZE : 0;
+    }
+    else if (page == GB_PAGE_OAM)
+    {
+        return sizeof(gb->ppu.oam);
+    }
+    else if (page == GB_PAGE_HRAM)
+    {
+        return sizeof(gb->mem.hram);
+    }
+    else if (page < GB_PAGE_COUNT)
+    {
+        return (size_t)(page - GB_PAGE_SRAM) * GB_PAGE_SIZE < get_state_sram_size(gb) ? GB_PAGE_SIZE : 0;
+    }
+
+    return 0;
+}
+
+// the page must exist, see get_page_size().
+static uint8_t* get_page_data(struct GB_Core* gb, uint16_t page)
+{
+    if (page < GB_PAGE_VRAM)
+    {
+        return gb->mem.wram[0] + (size_t)(page - GB_PAGE_WRAM) * GB_PAGE_SIZE;
+    }
+    else if (page < GB_PAGE_OAM)
+    {
+        return gb->ppu.vram[0] + (size_t)(page - GB_PAGE_VRAM) * GB_PAGE_SIZE;
+    }
+    else if (page == GB_PAGE_OAM)
+    {
+        return gb->ppu.oam;
+    }
+    else if (page == GB_PAGE_HRAM)
+    {
+        return gb->mem.hram;
+    }
+    else
+    {
+        return gb->ram + (size_t)(page - GB_PAGE_SRAM) * GB_PAGE_SIZE;
+    }
+}
+
+static bool is_page_dirty(const struct GB_Core* gb, uint16_t page)
+{
+    return (gb->dirty_pages[page >> 5] >> (page & 31)) & 1;
+}
+
+static void write_dirty_pages_chunk(const struct GB_Core* gb, struct StateWriter* w)
+{
+    struct StateChunkHeader header = { .tag = STATE_CHUNK_PAGE, .size = 0 };
+
+    // pages that don't exist on this system / cart are skipped, they
+    // can still be dirty after GB_mark_all_pages_dirty().
+    for (uint16_t page = 0; page < GB_PAGE_COUNT; page++)
+    {
+        const size_t size = get_page_size(gb, page);
+
+        if (size && is_page_dirty(gb, page))
+        {
+            header.size += sizeof(page) + size;
+        }
+    }
+
+    state_write(w, &header, sizeof(header));
+
+    for (uint16_t page = 0; page < GB_PAGE_COUNT; page++)
+    {
+        const size_t size = get_page_size(gb, page);
+
+        if (size && is_page_dirty(gb, page))
+        {
+            state_write(w, &page, sizeof(page));
+            state_write(w, GB_get_page(gb, page, NULL), size);
+        }
+    }
+}
+
+static size_t write_compact_state(const struct GB_Core* gb, uint8_t* data, size_t size, bool delta)
+{
+    struct StateWriter w = { .data = data, .offset = 0 };
+
+    const struct CompactStateHeader header =
+    {
+        .magic = COMPACT_STATE_MAGIC,
+        .version = COMPACT_STATE_VER,
+        .size = (uint32_t)size,
+        .gbc_enabled = GBC_ENABLE,
+        .sgb_enabled = SGB_ENABLE,
+        .system_type = (uint8_t)gb->system_type,
+        .flags = delta ? COMPACT_STATE_FLAG_DELTA : 0,
+    };
+
+    const uint8_t* mem = (const uint8_t*)&gb->mem;
+    const uint8_t* ppu = (const uint8_t*)&gb->ppu;
+
+    state_write(&w, &header, sizeof(header));
+    state_write_chunk(&w, STATE_CHUNK_CPU, &gb->cpu, sizeof(gb->cpu));
+    state_write_split_chunk(&w, STATE_CHUNK_MEM, mem, MEM_HEAD_SIZE, mem + MEM_TAIL_OFFSET, MEM_TAIL_SIZE);
+    state_write_split_chunk(&w, STATE_CHUNK_PPU, ppu, PPU_HEAD_SIZE, ppu + PPU_TAIL_OFFSET, PPU_TAIL_SIZE);
+    state_write_chunk(&w, STATE_CHUNK_APU, &gb->apu, sizeof(gb->apu));
+    state_write_chunk(&w, STATE_CHUNK_CART, &gb->cart, sizeof(gb->cart));
+    state_write_chunk(&w, STATE_CHUNK_TIMER, &gb->timer, sizeof(gb->timer));
+    state_write_chunk(&w, STATE_CHUNK_RUN, &gb->cycles_left_to_run, sizeof(gb->cycles_left_to_run));
+
+    if (delta)
+    {
+        write_dirty_pages_chunk(gb, &w);
+    }
+    else
+    {
+        const size_t sram_size = get_state_sram_size(gb);
+
+        state_write_chunk(&w, STATE_CHUNK_WRAM, gb->mem.wram, get_state_wram_size(gb));
+        state_write_chunk(&w, STATE_CHUNK_VRAM, gb->ppu.vram, get_state_vram_size(gb));
+
+        if (sram_size)
+        {
+            state_write_chunk(&w, STATE_CHUNK_SRAM, gb->ram, sram_size);
+        }
+    }
+
+    return w.offset;
+}
+
+// returns the data of the chunk and sets [chunk_size], or NULL if not found.
+static const uint8_t* find_state_chunk_any(const uint8_t* data, size_t size, enum StateChunkTag tag, size_t* chunk_size)
+{
+    size_t offset = sizeof(struct CompactStateHeader);
+
+    while (size - offset >= sizeof(struct StateChunkHeader))
+    {
+        struct StateChunkHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (header.size > size - offset)
+        {
+            return NULL;
+        }
+
+        if (header.tag == (uint32_t)tag)
+        {
+            *chunk_size = header.size;
+            return data + offset;
+        }
+
+        offset += header.size;
+    }
+
+    return NULL;
+}
+
+// returns the data of the chunk, or NULL if not found or the size is wrong.
+static const uint8_t* find_state_chunk(const uint8_t* data, size_t size, enum StateChunkTag tag, size_t expected_size)
+{
+    size_t chunk_size = 0;
+    const uint8_t* chunk = find_state_chunk_any(data, size, tag, &chunk_size);
+
+    return chunk && chunk_size == expected_size ? chunk : NULL;
+}
+
+// checks that every page in the chunk exists and fits.
+static bool validate_page_chunk(const struct GB_Core* gb, const uint8_t* data, size_t size)
+{
+    size_t offset = 0;
+
+    while (offset < size)
+    {
+        uint16_t page;
+
+        if (size - offset < sizeof(page))
+        {
+            return false;
+        }
+
+        memcpy(&page, data + offset, sizeof(page));
+        offset += sizeof(page);
+
+        const size_t page_size = get_page_size(gb, page);
+
+        if (!page_size || page_size > size - offset)
+        {
+            return false;
+        }
+
+        offset += page_size;
+    }
+
+    return true;
+}
+
+static void load_page_chunk(struct GB_Core* gb, const uint8_t* data, size_t size)
+{
+    size_t offset = 0;
+
+    while (offset < size)
     {
-        memcpy(gb->ram, state->sram, sram_size);
+        uint16_t page;
+        memcpy(&page, data + offset, sizeof(page));
+        offset += sizeof(page);
+
+        const size_t page_size = get_page_size(gb, page);
+        memcpy(get_page_data(gb, page), data + offset, page_size);
+        GB_mark_page_dirty(gb, page);
+        gb->ram_dirty |= page >= GB_PAGE_SRAM;
+        offset += page_size;
+    }
+}
+
+size_t GB_savestate_size(const struct GB_Core* gb)
+{
+    if (!gb->rom)
+    {
+        return 0;
+    }
+
+    return write_compact_state(gb, NULL, 0, false);
+}
+
+size_t GB_serialize_state(const struct GB_Core* gb, void* data, size_t size)
+{
+    const size_t state_size = GB_savestate_size(gb);
+
+    if (!data || !state_size || size < state_size)
+    {
+        return 0;
+    }
+
+    return write_compact_state(gb, data, state_size, false);
+}
+
+size_t GB_savestate_delta_size(const struct GB_Core* gb)
+{
+    if (!gb->rom)
+    {
+        return 0;
+    }
+
+    return write_compact_state(gb, NULL, 0, true);
+}
+
+size_t GB_serialize_state_delta(struct GB_Core* gb, void* data, size_t size)
+{
+    const size_t state_size = GB_savestate_delta_size(gb);
+
+    if (!data || !state_size || size < state_size)
+    {
+        return 0;
+    }
+
+    write_compact_state(gb, data, state_size, true);
+    GB_clear_dirty_pages(gb);
+
+    return state_size;
+}
+
+bool GB_deserialize_state(struct GB_Core* gb, const void* data, size_t size)
+{
+    struct CompactStateHeader header;
+
+    if (!data || !gb->rom || size < sizeof(header))
+    {
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != COMPACT_STATE_MAGIC || header.version != COMPACT_STATE_VER || header.size < sizeof(header) || header.size > size)
+    {
+        return false;
+    }
+
+    if (header.gbc_enabled != GBC_ENABLE || header.sgb_enabled != SGB_ENABLE || header.system_type != gb->system_type)
+    {
+        return false;
+    }
+
+    // find all chunks before loading anything, so that a bad state
+    // doesn't leave the core half loaded.
+    const uint8_t* chunks = data;
+    const bool delta = header.flags & COMPACT_STATE_FLAG_DELTA;
+
+    const uint8_t* cpu = find_state_chunk(chunks, header.size, STATE_CHUNK_CPU, sizeof(gb->cpu));
+    const uint8_t* mem = find_state_chunk(chunks, header.size, STATE_CHUNK_MEM, MEM_HEAD_SIZE + MEM_TAIL_SIZE);
+    const uint8_t* ppu = find_state_chunk(chunks, header.size, STATE_CHUNK_PPU, PPU_HEAD_SIZE + PPU_TAIL_SIZE);
+    const uint8_t* apu = find_state_chunk(chunks, header.size, STATE_CHUNK_APU, sizeof(gb->apu));
+    const uint8_t* cart = find_state_chunk(chunks, header.size, STATE_CHUNK_CART, sizeof(gb->cart));
+    const uint8_t* timer = find_state_chunk(chunks, header.size, STATE_CHUNK_TIMER, sizeof(gb->timer));
+
+    if (!cpu || !mem || !ppu || !apu || !cart || !timer)
+    {
+        return false;
+    }
+
+    const uint8_t* run = find_state_chunk(chunks, header.size, STATE_CHUNK_RUN, sizeof(gb->cycles_left_to_run));
+
+    const size_t sram_size = get_state_sram_size(gb);
+    const uint8_t* wram = NULL;
+    const uint8_t* vram = NULL;
+    const uint8_t* sram = NULL;
+    const uint8_t* pages = NULL;
+    size_t pages_size = 0;
+
+    if (delta)
+    {
+        pages = find_state_chunk_any(chunks, header.size, STATE_CHUNK_PAGE, &pages_size);
+
+        if (!pages || !validate_page_chunk(gb, pages, pages_size))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        wram = find_state_chunk(chunks, header.size, STATE_CHUNK_WRAM, get_state_wram_size(gb));
+        vram = find_state_chunk(chunks, header.size, STATE_CHUNK_VRAM, get_state_vram_size(gb));
+        sram = sram_size ? find_state_chunk(chunks, header.size, STATE_CHUNK_SRAM, sram_size) : NULL;
+
+        if (!wram || !vram || (sram_size && !sram))
+        {
+            return false;
+        }
+    }
+
+    uint8_t* gb_mem = (uint8_t*)&gb->mem;
+    uint8_t* gb_ppu = (uint8_t*)&gb->ppu;
+
+    memcpy(&gb->cpu, cpu, sizeof(gb->cpu));
+    memcpy(gb_mem, mem, MEM_HEAD_SIZE);
+    memcpy(gb_mem + MEM_TAIL_OFFSET, mem + MEM_HEAD_SIZE, MEM_TAIL_SIZE);
+    memcpy(gb_ppu, ppu, PPU_HEAD_SIZE);
+    memcpy(gb_ppu + PPU_TAIL_OFFSET, ppu + PPU_HEAD_SIZE, PPU_TAIL_SIZE);
+    memcpy(&gb->apu, apu, sizeof(gb->apu));
+    memcpy(&gb->cart, cart, sizeof(gb->cart));
+    memcpy(&gb->timer, timer, sizeof(gb->timer));
+
+    if (run)
+    {
+        memcpy(&gb->cycles_left_to_run, run, sizeof(gb->cycles_left_to_run));
+    }
+
+    if (delta)
+    {
+        // the oam / hram in the ppu / mem chunks are the latest
+        // and only the dirty pages changed, so only mark those.
+        GB_mark_page_dirty(gb, GB_PAGE_OAM);
+        GB_mark_page_dirty(gb, GB_PAGE_HRAM);
+        load_page_chunk(gb, pages, pages_size);
+    }
+    else
+    {
+        memcpy(gb->mem.wram, wram, get_state_wram_size(gb));
+        memcpy(gb->ppu.vram, vram, get_state_vram_size(gb));
+
+        if (sram_size)
+        {
+            load_sram(gb, sram, sram_size);
+        }
+
+        GB_mark_all_pages_dirty(gb);
     }
 
     // we need to reload mmaps
@@ -717,6 +1369,85 @@ bool GB_loadstate(struct GB_Core* gb, const struct GB_State* state)
     return true;
 }
 
+const uint8_t* GB_get_page(const struct GB_Core* gb, uint16_t page, size_t* size)
+{
+    const size_t page_size = get_page_size(gb, page);
+
+    if (size)
+    {
+        *size = page_size;
+    }
+
+    if (!page_size)
+    {
+        return NULL;
+    }
+
+    if (page < GB_PAGE_VRAM)
+    {
+        return gb->mem.wram[0] + (size_t)(page - GB_PAGE_WRAM) * GB_PAGE_SIZE;
+    }
+    else if (page < GB_PAGE_OAM)
+    {
+        return gb->ppu.vram[0] + (size_t)(page - GB_PAGE_VRAM) * GB_PAGE_SIZE;
+    }
+    else if (page == GB_PAGE_OAM)
+    {
+        return gb->ppu.oam;
+    }
+    else if (page == GB_PAGE_HRAM)
+    {
+        return gb->mem.hram;
+    }
+    else
+    {
+        return gb->ram + (size_t)(page - GB_PAGE_SRAM) * GB_PAGE_SIZE;
+    }
+}
+
+size_t GB_get_dirty_pages(const struct GB_Core* gb, uint16_t* pages, size_t max)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(gb->dirty_pages); i++)
+    {
+        const uint32_t bits = gb->dirty_pages[i];
+
+        if (!bits)
+        {
+            continue;
+        }
+
+        for (uint16_t bit = 0; bit < 32 && count < max; bit++)
+        {
+            const uint16_t page = (uint16_t)(i * 32 + bit);
+
+            // pages that don't exist on this system / cart are skipped
+            if ((bits >> bit) & 1 && get_page_size(gb, page))
+            {
+                pages[count++] = page;
+            }
+        }
+    }
+
+    return count;
+}
+
+void GB_clear_dirty_pages(struct GB_Core* gb)
+{
+    memset(gb->dirty_pages, 0, sizeof(gb->dirty_pages));
+}
+
+void GB_mark_all_pages_dirty(struct GB_Core* gb)
+{
+    memset(gb->dirty_pages, 0xFF, sizeof(gb->dirty_pages));
+}
+
+void GB_mark_page_dirty(struct GB_Core* gb, uint16_t page)
+{
+    gb->dirty_pages[page >> 5] |= 1u << (page & 31);
+}
+
 void GB_enable_interrupt(struct GB_Core* gb, const enum GB_Interrupts interrupt)
 {
     IO_IF |= interrupt;
@@ -727,24 +1458,83 @@ void GB_disable_interrupt(struct GB_Core* gb, const enum GB_Interrupts interrupt
     IO_IF &= ~(interrupt);
 }
 
-void GB_set_apu_freq(struct GB_Core* gb, unsigned freq)
+static void update_apu_factor(struct GB_Core* gb)
 {
-    if (freq)
+    // max cycles to batch the apu for, this is ~1ms.
+    enum { MAX_SYNC_CYCLES = 4096 };
+    // max cycles to batch for when audio is off, this is ~250ms.
+    enum { MAX_SKIP_CYCLES = 0x100000 };
+
+    // keeps the dc blocking filter's cutoff at ~15hz for any freq
+    gb->callback.apu_data.hpf_shift = 1;
+    while ((gb->callback.apu_data.freq >> gb->callback.apu_data.hpf_shift) > 128)
     {
-        const float r = (float)GB_CPU_CYCLES / (float)freq;
-        // this basically rounds up the decimal, so 43.5 will be 44
-        gb->callback.apu_data.freq_reload = (uint16_t)(r + 0.5f);
+        gb->callback.apu_data.hpf_shift++;
+    }
+
+    const uint64_t factor = ((uint64_t)gb->callback.apu_data.freq << 32) / GB_CPU_CYCLES;
+    // can't output more than 1 sample per cycle
+    gb->callback.apu_data.factor = MIN((factor * gb->callback.apu_data.ratio) >> 16, (uint64_t)1 << 32);
+
+    if (gb->callback.apu_data.factor)
+    {
+        // keep each batch to half the size of the blip buffer
+        const uint64_t max = ((uint64_t)(GB_APU_BLIP_SIZE / 2) << 32) / gb->callback.apu_data.factor;
+        gb->callback.apu_data.sync_cycles = (uint32_t)MIN(max, MAX_SYNC_CYCLES);
     }
     else
     {
-        gb->callback.apu_data.freq_reload = 0;
+        // audio is off, so only sync when the game can see the state,
+        // which the frame sequencer and io access already do.
+        gb->callback.apu_data.sync_cycles = MAX_SKIP_CYCLES;
     }
 }
 
-void GB_set_apu_callback(struct GB_Core* gb, GB_apu_callback_t cb, void* user, unsigned freq)
+void GB_set_apu_freq(struct GB_Core* gb, unsigned freq)
+{
+    // run any pending cycles at the old rate
+    GB_apu_sync(gb);
+
+    gb->callback.apu_data.freq = MIN(freq, GB_CPU_CYCLES);
+    update_apu_factor(gb);
+}
+
+unsigned GB_get_apu_freq(const struct GB_Core* gb)
+{
+    return gb->callback.apu_data.freq;
+}
+
+void GB_set_apu_ratio(struct GB_Core* gb, uint32_t ratio)
 {
-    gb->callback.apu = cb;
-    gb->callback.user_apu = user;
+    GB_apu_sync(gb);
+
+    // a ratio of 0 would turn audio off, which isn't what the caller wants
+    gb->callback.apu_data.ratio = MAX(ratio, 1);
+    update_apu_factor(gb);
+}
+
+void GB_set_apu_gain(struct GB_Core* gb, uint32_t gain)
+{
+    GB_apu_sync(gb);
+
+    gb->callback.apu_data.gain = MIN(gain, GB_APU_GAIN_MAX);
+}
+
+void GB_set_apu_resampler(struct GB_Core* gb, enum GB_ApuResampler resampler)
+{
+    GB_apu_sync(gb);
+
+    gb->callback.apu_data.resampler = resampler;
+}
+
+void GB_set_apu_block_callback(struct GB_Core* gb, GB_apu_block_callback_t cb, void* user, unsigned freq, uint32_t frames)
+{
+    gb->callback.apu_block = cb;
+    gb->callback.user_apu_block = user;
+    gb->callback.apu_data.block_frames = frames ? MIN(frames, GB_APU_BUFFER_FRAMES) : 512;
+
+    // drop anything left over from before
+    gb->apu_buffer.read = gb->apu_buffer.write = 0;
 
     GB_set_apu_freq(gb, freq);
 }
@@ -789,6 +1579,7 @@ void GB_set_rom_bank_callback(struct GB_Core* gb, GB_rom_bank_callback_t cb, voi
 {
     gb->callback.rom_bank = cb;
     gb->callback.user_rom_bank = user;
+    GB_setup_mbc_ops(gb);
 }
 
 #if GB_DEBUG
@@ -848,8 +1639,16 @@ void GB_run(struct GB_Core* gb, uint32_t tcycles)
     // modify the cycles via callback
     gb->cycles_left_to_run += tcycles;
 
+    // cycles ran this call, used to time queued input.
+    uint32_t elapsed = 0;
+
     while (gb->cycles_left_to_run > 0)
     {
+        if (UNLIKELY(elapsed >= gb->input_queue.next_cycle))
+        {
+            GB_input_queue_run(gb, elapsed);
+        }
+
         const uint16_t cycles = GB_cpu_run(gb, 0 /*unused*/);
 
         GB_timer_run(gb, cycles);
@@ -859,5 +1658,25 @@ void GB_run(struct GB_Core* gb, uint32_t tcycles)
         assert(gb->cpu.double_speed == 1 || gb->cpu.double_speed == 0);
 
         gb->cycles_left_to_run -= cycles >> gb->cpu.double_speed;
+        elapsed += cycles >> gb->cpu.double_speed;
+    }
+
+    // the run can end slightly early as it overshot last time,
+    // so apply the events that belong to this run now.
+    if (gb->input_queue.count && tcycles)
+    {
+        GB_input_queue_run(gb, tcycles - 1);
+
+        // the rest are relative to the next run
+        for (uint16_t i = 0; i < gb->input_queue.count; i++)
+        {
+            const uint16_t index = (gb->input_queue.read + i) & (GB_INPUT_QUEUE_SIZE - 1);
+            gb->input_queue.events[index].cycle -= tcycles;
+        }
+
+        if (gb->input_queue.count)
+        {
+            gb->input_queue.next_cycle -= tcycles;
+        }
     }
 }
@@ -19,6 +19,10 @@ GBAPI void GB_set_pixels(struct GB_Core* gb, void* pixels, uint32_t stride, uint
 
 // todo: explain this function
 GBAPI void GB_set_sram(struct GB_Core* gb, uint8_t* ram, size_t size);
+// set when the game writes to sram, or loading a state changes it.
+// useful for only writing the save when needed.
+GBAPI bool GB_is_sram_dirty(const struct GB_Core* gb);
+GBAPI void GB_clear_sram_dirty(struct GB_Core* gb);
 
 // todo: explain this function
 GBAPI bool GB_get_rom_info(const uint8_t* data, size_t size, struct GB_RomInfo* info_out);
@@ -28,6 +32,11 @@ GBAPI bool GB_get_rom_info(const uint8_t* data, size_t size, struct GB_RomInfo*
 // freeing the memory should still be handled by the caller!
 GBAPI bool GB_loadrom(struct GB_Core* gb, const uint8_t* data, size_t size);
 
+// same as GB_loadrom(), but [data] only needs to contain bank 0, ie,
+// a compressed rom. the rom bank callback must be set beforehand as it
+// provides the rest of the banks, see GB_set_rom_bank_callback().
+GBAPI bool GB_loadrom_partial(struct GB_Core* gb, const uint8_t* data, size_t size);
+
 GBAPI bool GB_has_save(const struct GB_Core* gb);
 GBAPI bool GB_has_rtc(const struct GB_Core* gb);
 
@@ -36,12 +45,49 @@ GBAPI size_t GB_calculate_savedata_size(const struct GB_Core* gb);
 // save/loadstate to struct.
 GBAPI bool GB_savestate(const struct GB_Core* gb, struct GB_State* state);
 GBAPI bool GB_loadstate(struct GB_Core* gb, const struct GB_State* state);
+// same as GB_savestate() but the unused part of state->sram isn't cleared,
+// so this only costs a copy of the used state.
+// use this for states that stay in memory, ie, run-ahead.
+GBAPI bool GB_quicksave(const struct GB_Core* gb, struct GB_State* state);
+
+// copies the emulation state of [src] into [dst], this is much faster than
+// a save / loadstate. the rom is shared, the sram is copied into the buffer
+// set on [dst] with GB_set_sram(), which must be big enough (fails otherwise).
+// if [src] uses a rom bank callback, [dst] must have loaded the same rom
+// with the same callback, ie, its own zrom (fails otherwise).
+// [dst] keeps its own pixels, callbacks, audio settings and link cable.
+GBAPI bool GB_clone(struct GB_Core* dst, const struct GB_Core* src);
+
+// compact variable sized savestate, only the sram the cart has and the
+// wram / vram banks that exist on the current system are saved.
+// the size is fixed for the loaded rom.
+GBAPI size_t GB_savestate_size(const struct GB_Core* gb);
+// returns the number of bytes written, 0 on error or if [size] is too small.
+GBAPI size_t GB_serialize_state(const struct GB_Core* gb, void* data, size_t size);
+GBAPI bool GB_deserialize_state(struct GB_Core* gb, const void* data, size_t size);
+
+// wram, vram, oam, hram and cart ram are tracked in GB_PAGE_SIZE pages,
+// a page is marked dirty when written to. loading a state, or a reset,
+// marks every page as dirty.
+// writes the index of up to [max] dirty pages into [pages], returns the count.
+GBAPI size_t GB_get_dirty_pages(const struct GB_Core* gb, uint16_t* pages, size_t max);
+GBAPI void GB_clear_dirty_pages(struct GB_Core* gb);
+// returns the page data and sets [size] (optional), NULL if the page
+// doesn't exist on this system / cart.
+GBAPI const uint8_t* GB_get_page(const struct GB_Core* gb, uint16_t page, size_t* size);
+// same as GB_serialize_state() but only the pages written to since the last
+// delta (or GB_clear_dirty_pages()) are saved, the dirty pages are then cleared.
+// a delta can only be loaded on top of the state it was taken after.
+GBAPI size_t GB_savestate_delta_size(const struct GB_Core* gb);
+GBAPI size_t GB_serialize_state_delta(struct GB_Core* gb, void* data, size_t size);
 
 // pass in filled out rtc struct.
 // NOTE: the s, m, h will be clamped to the max values
 // so there won't be 255 seconds, it'll be clamped to 59.
 // returns false if the game does not support rtc.
 GBAPI bool GB_set_rtc(struct GB_Core* gb, const struct GB_Rtc rtc);
+// returns false if the game does not support rtc.
+GBAPI bool GB_get_rtc(const struct GB_Core* gb, struct GB_Rtc* rtc);
 
 // this will work even if the game does NOT have RTC
 // this setting persits accross games!
@@ -61,11 +107,35 @@ GBAPI bool GB_is_system_gbc(const struct GB_Core* gb);
 GBAPI int GB_get_rom_name(const struct GB_Core* gb, struct GB_CartName* name);
 GBAPI int GB_get_rom_name_from_header(const struct GB_CartHeader* header, struct GB_CartName* name);
 
+/* a freq of 0 (the default) turns audio off, the channels are then not */
+/* synthesised, only the state visible to the game is kept (NR52, length */
+/* counters and wave ram reads). this is much faster for headless use. */
 GBAPI void GB_set_apu_freq(struct GB_Core* gb, unsigned freq);
+GBAPI unsigned GB_get_apu_freq(const struct GB_Core* gb);
+
+/* fine adjusts the output rate, the actual rate is freq * ratio. */
+/* ratio is 16.16 fixed point, GB_APU_RATIO_ONE is 1.0 (the default). */
+/* this is cheap, so it can be called every frame, ie, to keep the */
+/* frontend's audio buffer at a target fill level. */
+GBAPI void GB_set_apu_ratio(struct GB_Core* gb, uint32_t ratio);
+
+/* master volume, 8.8 fixed point, GB_APU_GAIN_ONE is 1.0 (the default). */
+/* the output saturates rather than wrapping, max is GB_APU_GAIN_MAX. */
+GBAPI void GB_set_apu_gain(struct GB_Core* gb, uint32_t gain);
 
-/* set a callback which will be called when apu has filled 512 stero samples. */
+/* default is GB_APU_RESAMPLER_SINC. */
+GBAPI void GB_set_apu_resampler(struct GB_Core* gb, enum GB_ApuResampler resampler);
+
+/* set a callback which will be called when apu has filled [frames] */
+/* interleaved int16 stereo samples, 0 defaults to 512 frames. */
 /* not setting this callback is valid, just that you won't have audio... */
-GBAPI void GB_set_apu_callback(struct GB_Core* gb, GB_apu_callback_t cb, void* user, unsigned freq);
+GBAPI void GB_set_apu_block_callback(struct GB_Core* gb, GB_apu_block_callback_t cb, void* user, unsigned freq, uint32_t frames);
+
+/* pull api, use this instead of a callback, set the freq with */
+/* GB_set_apu_freq(). if the buffer fills, the oldest frames are dropped. */
+GBAPI uint32_t GB_get_apu_samples_available(const struct GB_Core* gb);
+/* copies up to [frames] stereo frames, returns the number copied. */
+GBAPI uint32_t GB_read_apu_samples(struct GB_Core* gb, int16_t* samples, uint32_t frames);
 
 /* set a callback which will be called when vblank happens. */
 GBAPI void GB_set_vblank_callback(struct GB_Core* gb, GB_vblank_callback_t cb, void* user);
@@ -84,6 +154,8 @@ GBAPI void GB_set_stop_callback(struct GB_Core* gb, GB_stop_callback_t cb, void*
 
 GBAPI void GB_set_colour_callback(struct GB_Core* gb, GB_colour_callback_t cb, void* user);
 
+// if set, the callback provides the rom banks. if it fails, the bank is
+// mapped from the rom data, anything past the data is open bus.
 GBAPI void GB_set_rom_bank_callback(struct GB_Core* gb, GB_rom_bank_callback_t cb, void* user);
 
 /* set a callback which will be called when link transfer happens. */
@@ -101,6 +173,17 @@ GBAPI void GB_set_buttons(struct GB_Core* gb, uint8_t buttons, bool is_down);
 GBAPI uint8_t GB_get_buttons(const struct GB_Core* gb);
 GBAPI bool GB_is_button_down(const struct GB_Core* gb, enum GB_Button button);
 
+// queues the buttons that are held down (GB_Button mask) to be set at
+// [cycle], which is relative to the start of the next GB_run() call.
+// events must be queued in order, any that are not yet reached by the
+// end of GB_run() are carried over to the next call.
+// returns false if the queue is full.
+GBAPI bool GB_queue_buttons(struct GB_Core* gb, uint32_t cycle, uint8_t buttons);
+GBAPI void GB_clear_input_queue(struct GB_Core* gb);
+// copies up to [max] queued events (oldest first) into [events],
+// returns the count. the cycles are relative to the next GB_run().
+GBAPI size_t GB_get_queued_buttons(const struct GB_Core* gb, struct GB_InputEvent* events, size_t max);
+
 // make this a seperate header, gb_adv.h, add these there
 GBAPI bool GB_get_rom_palette_hash_from_header(const struct GB_CartHeader* header, uint8_t* hash, uint8_t* forth);
 
@@ -222,6 +222,8 @@ GB_FORCE_INLINE void GB_tac_write(struct GB_Core* gb, uint8_t value);
 GB_STATIC bool GB_get_mbc_flags(uint8_t cart_type, uint8_t* flags_out);
 GB_STATIC bool GB_get_cart_ram_size(const struct GB_CartHeader* header, uint32_t* size);
 GB_STATIC bool GB_setup_mbc(struct GB_Core* gb, const struct GB_CartHeader* header);
+// call this whenever the cart type or rom bank callback changes.
+GB_STATIC void GB_setup_mbc_ops(struct GB_Core* gb);
 GB_STATIC void GB_setup_mmap(struct GB_Core* gb);
 GB_FORCE_INLINE void GB_update_rom_banks(struct GB_Core* gb);
 GB_FORCE_INLINE void GB_update_ram_banks(struct GB_Core* gb);
@@ -240,6 +242,12 @@ GB_FORCE_INLINE enum GB_StatusModes GB_get_status_mode(const struct GB_Core* gb)
 GB_FORCE_INLINE void GB_compare_LYC(struct GB_Core* gb);
 
 GB_INLINE void GB_joypad_write(struct GB_Core* gb, uint8_t value);
+// applies all queued input events up to and including [cycle].
+GB_STATIC void GB_input_queue_run(struct GB_Core* gb, uint32_t cycle);
+
+// marks a page as written to, see enum GB_Page.
+GB_FORCE_INLINE void GB_mark_page_dirty(struct GB_Core* gb, uint16_t page);
+GB_STATIC void GB_mark_all_pages_dirty(struct GB_Core* gb);
 
 GB_FORCE_INLINE void GB_enable_interrupt(struct GB_Core* gb, const enum GB_Interrupts interrupt);
 GB_FORCE_INLINE void GB_disable_interrupt(struct GB_Core* gb, const enum GB_Interrupts interrupt);
@@ -249,6 +257,8 @@ GB_FORCE_INLINE uint16_t GB_cpu_run(struct GB_Core* gb, uint16_t cycles);
 GB_FORCE_INLINE void GB_timer_run(struct GB_Core* gb, uint16_t cycles);
 GB_FORCE_INLINE void GB_ppu_run(struct GB_Core* gb, uint16_t cycles);
 GB_FORCE_INLINE void GB_apu_run(struct GB_Core* gb, uint16_t cycles);
+// runs the apu for any batched cycles, call before accessing apu state.
+GB_STATIC void GB_apu_sync(struct GB_Core* gb);
 
 GB_FORCE_INLINE bool GB_is_lcd_enabled(const struct GB_Core* gb);
 GB_FORCE_INLINE bool GB_is_win_enabled(const struct GB_Core* gb);
@@ -12,18 +12,12 @@ static inline bool GB_is_button(const struct GB_Core* gb)
     return !(IO_JYP & 0x20);
 }
 
-// [API]
-void GB_set_buttons(struct GB_Core* gb, uint8_t buttons, bool is_down)
+static void GB_update_buttons(struct GB_Core* gb, uint8_t buttons, bool is_down)
 {
     // the pins go LOW when pressed!
     if (is_down)
     {
         gb->joypad.var &= ~buttons;
-
-        // this isn't correct impl, it needs to fire when going hi to lo.
-        // but it's good enough for now.
-        GB_enable_interrupt(gb, GB_INTERRUPT_JOYPAD);
-
     }
     else
     {
@@ -59,6 +53,96 @@ void GB_set_buttons(struct GB_Core* gb, uint8_t buttons, bool is_down)
     }
 }
 
+// [API]
+void GB_set_buttons(struct GB_Core* gb, uint8_t buttons, bool is_down)
+{
+    GB_update_buttons(gb, buttons, is_down);
+
+    if (is_down)
+    {
+        // this isn't correct impl, it needs to fire when going hi to lo.
+        // but it's good enough for now.
+        GB_enable_interrupt(gb, GB_INTERRUPT_JOYPAD);
+    }
+}
+
+bool GB_queue_buttons(struct GB_Core* gb, uint32_t cycle, uint8_t buttons)
+{
+    struct GB_InputQueue* queue = &gb->input_queue;
+
+    if (queue->count == GB_INPUT_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    if (queue->count)
+    {
+        const uint16_t last = (queue->read + queue->count - 1) & (GB_INPUT_QUEUE_SIZE - 1);
+
+        // keep the queue in order
+        cycle = MAX(cycle, queue->events[last].cycle);
+    }
+    else
+    {
+        queue->next_cycle = cycle;
+    }
+
+    const uint16_t index = (queue->read + queue->count) & (GB_INPUT_QUEUE_SIZE - 1);
+    queue->events[index].cycle = cycle;
+    queue->events[index].buttons = buttons;
+    queue->count++;
+
+    return true;
+}
+
+void GB_clear_input_queue(struct GB_Core* gb)
+{
+    gb->input_queue.read = 0;
+    gb->input_queue.count = 0;
+    gb->input_queue.next_cycle = UINT32_MAX;
+}
+
+size_t GB_get_queued_buttons(const struct GB_Core* gb, struct GB_InputEvent* events, size_t max)
+{
+    const struct GB_InputQueue* queue = &gb->input_queue;
+    const size_t count = queue->count < max ? queue->count : max;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        events[i] = queue->events[(queue->read + i) & (GB_INPUT_QUEUE_SIZE - 1)];
+    }
+
+    return count;
+}
+
+void GB_input_queue_run(struct GB_Core* gb, uint32_t cycle)
+{
+    struct GB_InputQueue* queue = &gb->input_queue;
+
+    while (queue->count && queue->events[queue->read].cycle <= cycle)
+    {
+        const uint8_t buttons = queue->events[queue->read].buttons;
+        // pressed buttons are the ones that go from hi to lo
+        const uint8_t pressed = buttons & gb->joypad.var;
+
+        GB_update_buttons(gb, (uint8_t)~buttons, false);
+        GB_update_buttons(gb, pressed, true);
+
+        // the interrupt only fires if the line of the pressed
+        // button is currently selected.
+        if ((GB_is_button(gb) && (pressed & 0x0F)) ||
+            (GB_is_directional(gb) && (pressed & 0xF0)))
+        {
+            GB_enable_interrupt(gb, GB_INTERRUPT_JOYPAD);
+        }
+
+        queue->read = (queue->read + 1) & (GB_INPUT_QUEUE_SIZE - 1);
+        queue->count--;
+    }
+
+    queue->next_cycle = queue->count ? queue->events[queue->read].cycle : UINT32_MAX;
+}
+
 uint8_t GB_get_buttons(const struct GB_Core* gb)
 {
     return gb->joypad.var;
@@ -14,52 +14,93 @@ struct MbcInfo
 
 void mbc_write(struct GB_Core *gb, uint16_t addr, uint8_t value)
 {
-    switch (gb->cart.type)
-    {
-        case GB_MbcType_0: mbc0_write(gb, addr, value); break;
-        case GB_MbcType_1: mbc1_write(gb, addr, value); break;
-        case GB_MbcType_2: mbc2_write(gb, addr, value); break;
-        case GB_MbcType_3: mbc3_write(gb, addr, value); break;
-        case GB_MbcType_5: mbc5_write(gb, addr, value); break;
-    }
+    gb->mbc_ops.write(gb, addr, value);
+}
+
+void mbc_ram_write(struct GB_Core* gb, uint32_t offset, uint8_t value)
+{
+    gb->ram[offset] = value;
+    gb->ram_dirty = true;
+    GB_mark_page_dirty(gb, GB_PAGE_SRAM + (offset >> 8));
 }
 
 struct MBC_RomBankInfo mbc_get_rom_bank(struct GB_Core *gb, uint8_t bank)
 {
-    if (gb->callback.rom_bank)
-    {
-        struct MBC_RomBankInfo info = {0};
+    return gb->mbc_ops.get_rom_bank(gb, bank);
+}
 
-        if (gb->callback.rom_bank(gb->callback.user_rom_bank, &info, gb->cart.type, bank * gb->cart.rom_bank))
-        {
-            return info;
-        }
+struct MBC_RamBankInfo mbc_get_ram_bank(struct GB_Core *gb)
+{
+    return gb->mbc_ops.get_ram_bank(gb);
+}
+
+// only used when a rom bank callback is set.
+static struct MBC_RomBankInfo mbc_get_rom_bank_callback(struct GB_Core* gb, uint8_t bank)
+{
+    static const uint8_t MBC_NO_ROM = 0xFF;
+    struct MBC_RomBankInfo info = {0};
+
+    if (gb->callback.rom_bank(gb->callback.user_rom_bank, &info, gb->cart.type, bank * gb->cart.rom_bank))
+    {
+        return info;
     }
 
-    switch (gb->cart.type)
+    // fallback to the rom data, which is only bank 0 for a partial rom,
+    // anything outside of it is open bus rather than reading past the end.
+    info = gb->mbc_ops.get_cart_rom_bank(gb, bank);
+
+    for (size_t i = 0; i < ARRAY_SIZE(info.entries); i++)
     {
-        case GB_MbcType_0: return mbc0_get_rom_bank(gb, bank);
-        case GB_MbcType_1: return mbc1_get_rom_bank(gb, bank);
-        case GB_MbcType_2: return mbc2_get_rom_bank(gb, bank);
-        case GB_MbcType_3: return mbc3_get_rom_bank(gb, bank);
-        case GB_MbcType_5: return mbc5_get_rom_bank(gb, bank);
+        if ((size_t)(info.entries[i].ptr - gb->rom) + 0x1000 > gb->rom_size)
+        {
+            info.entries[i].ptr = &MBC_NO_ROM;
+            info.entries[i].mask = 0;
+        }
     }
 
-    UNREACHABLE((struct MBC_RomBankInfo){0});
+    return info;
 }
 
-struct MBC_RamBankInfo mbc_get_ram_bank(struct GB_Core *gb)
+void GB_setup_mbc_ops(struct GB_Core* gb)
 {
+    struct GB_MbcOps* ops = &gb->mbc_ops;
+
     switch (gb->cart.type)
     {
-        case GB_MbcType_0: return mbc0_get_ram_bank(gb);
-        case GB_MbcType_1: return mbc1_get_ram_bank(gb);
-        case GB_MbcType_2: return mbc2_get_ram_bank(gb);
-        case GB_MbcType_3: return mbc3_get_ram_bank(gb);
-        case GB_MbcType_5: return mbc5_get_ram_bank(gb);
+        case GB_MbcType_1:
+            ops->write = mbc1_write;
+            ops->get_cart_rom_bank = mbc1_get_rom_bank;
+            ops->get_ram_bank = mbc1_get_ram_bank;
+            break;
+
+        case GB_MbcType_2:
+            ops->write = mbc2_write;
+            ops->get_cart_rom_bank = mbc2_get_rom_bank;
+            ops->get_ram_bank = mbc2_get_ram_bank;
+            break;
+
+        case GB_MbcType_3:
+            ops->write = mbc3_write;
+            ops->get_cart_rom_bank = mbc3_get_rom_bank;
+            ops->get_ram_bank = mbc3_get_ram_bank;
+            break;
+
+        case GB_MbcType_5:
+            ops->write = mbc5_write;
+            ops->get_cart_rom_bank = mbc5_get_rom_bank;
+            ops->get_ram_bank = mbc5_get_ram_bank;
+            break;
+
+        // also used before a rom is loaded, so the ops are never NULL.
+        case GB_MbcType_0:
+        default:
+            ops->write = mbc0_write;
+            ops->get_cart_rom_bank = mbc0_get_rom_bank;
+            ops->get_ram_bank = mbc0_get_ram_bank;
+            break;
     }
 
-    UNREACHABLE((struct MBC_RamBankInfo){0});
+    ops->get_rom_bank = gb->callback.rom_bank ? mbc_get_rom_bank_callback : ops->get_cart_rom_bank;
 }
 
 // NOTE: this assumes that the rest of the entries will be zero init!
@@ -218,6 +259,7 @@ bool GB_setup_mbc(struct GB_Core* gb, const struct GB_CartHeader* header)
 
     gb->cart.type = info->type;
     gb->cart.flags = info->flags;
+    GB_setup_mbc_ops(gb);
 
     // todo: create mbcx_init() functions
     if (gb->cart.type == GB_MbcType_0)
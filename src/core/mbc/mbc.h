@@ -11,6 +11,8 @@ extern "C" {
 GB_INLINE void mbc_write(struct GB_Core *gb, uint16_t addr, uint8_t value);
 GB_INLINE struct MBC_RomBankInfo mbc_get_rom_bank(struct GB_Core *gb, uint8_t bank);
 GB_INLINE struct MBC_RamBankInfo mbc_get_ram_bank(struct GB_Core *gb);
+// all writes to cart ram go through here, [offset] is into gb->ram.
+GB_FORCE_INLINE void mbc_ram_write(struct GB_Core* gb, uint32_t offset, uint8_t value);
 
 
 GB_STATIC struct MBC_RamBankInfo mbc_setup_empty_ram(void);
@@ -62,7 +62,7 @@ void mbc1_write(struct GB_Core* gb, uint16_t addr, uint8_t value)
             {
                 return;
             }
-            gb->ram[(addr & 0x1FFF) + (0x2000 * (gb->cart.bank_mode == 1 ? gb->cart.ram_bank : 0))] = value;
+            mbc_ram_write(gb, (addr & 0x1FFF) + (0x2000 * (gb->cart.bank_mode == 1 ? gb->cart.ram_bank : 0)), value);
             break;
     }
 }
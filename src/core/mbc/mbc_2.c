@@ -35,7 +35,7 @@ void mbc2_write(struct GB_Core* gb, uint16_t addr, uint8_t value)
             const uint8_t masked_value = (value & 0x0F) | 0xF0;
             const uint16_t masked_addr = addr & 0x1FF;
 
-            gb->ram[masked_addr] = masked_value;
+            mbc_ram_write(gb, masked_addr, masked_value);
         } break;
     }
 }
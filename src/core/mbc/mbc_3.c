@@ -156,7 +156,7 @@ void mbc3_write(struct GB_Core* gb, uint16_t addr, uint8_t value)
             {
                 if (gb->cart.in_ram)
                 {
-                    gb->ram[(addr & 0x1FFF) + (0x2000 * gb->cart.ram_bank)] = value;
+                    mbc_ram_write(gb, (addr & 0x1FFF) + (0x2000 * gb->cart.ram_bank), value);
                 }
                 else if (GB_has_mbc_flags(gb, MBC_FLAGS_RTC))
                 {
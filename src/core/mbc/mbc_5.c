@@ -48,7 +48,7 @@ void mbc5_write(struct GB_Core* gb, uint16_t addr, uint8_t value)
         case 0xA: case 0xB:
             if ((gb->cart.flags & MBC_FLAGS_RAM) && gb->cart.ram_enabled)
             {
-                gb->ram[(addr & 0x1FFF) + (0x2000 * gb->cart.ram_bank)] = value;
+                mbc_ram_write(gb, (addr & 0x1FFF) + (0x2000 * gb->cart.ram_bank), value);
             }
             break;
     }
@@ -15,59 +15,95 @@ struct DmgPrioBuf
     uint8_t colour_id[GB_SCREEN_WIDTH];
 };
 
+struct DmgSpan
+{
+    // the register values used for this span of the line
+    struct GB_PpuLineRegs regs;
+
+    const uint32_t* bg_colours;
+    const uint32_t* obj_colours[2];
+
+    // pixels [start, end)
+    uint8_t start;
+    uint8_t end;
+};
+
 static FORCE_INLINE uint16_t calculate_col_from_palette(const uint8_t palette, const uint8_t colour)
 {
     return ((palette >> (colour << 1)) & 3);
 }
 
-static void dmg_update_colours(struct GB_PalCache cache[20], uint32_t colours[20][4], bool* dirty, const uint32_t pal_colours[4], const uint8_t palette_reg)
+static FORCE_INLINE void dmg_build_colours(uint32_t colours[4], const uint32_t pal_colours[4], const uint8_t palette)
 {
-    if (*dirty == false)
+    for (uint8_t i = 0; i < 4; ++i)
     {
-        // reset cache so old entries don't persist
-        memset(cache, 0, sizeof(struct GB_PalCache) * 20);
-        return;
+        colours[i] = pal_colours[calculate_col_from_palette(palette, i)];
     }
+}
 
-    *dirty = false;
-    uint8_t palette = palette_reg;
-
-    for (uint8_t i = 0; i < 20; ++i)
+static FORCE_INLINE void dmg_update_colours(uint32_t colours[4], bool* dirty, const uint32_t pal_colours[4], const uint8_t palette)
+{
+    if (*dirty)
     {
-        if (cache[i].used)
-        {
-            // this is needed for now, see prehistorik man text intro
-            *dirty = true;
-
-            cache[i].used = false;
-            palette = cache[i].pal;
-        }
-
-        for (uint8_t j = 0; j < 4; ++j)
-        {
-            colours[i][j] = pal_colours[calculate_col_from_palette(palette, j)];
-        }
+        *dirty = false;
+        dmg_build_colours(colours, pal_colours, palette);
     }
 }
 
-static FORCE_INLINE void on_dmg_palette_write(const struct GB_Core* gb, struct GB_PalCache cache[20], bool* dirty, uint8_t palette, uint8_t value)
+static FORCE_INLINE void dmg_log_reg_write(struct GB_Core* gb, const uint8_t reg, const uint8_t value)
 {
-    *dirty |= palette != value;
+    struct GB_PpuLineLog* log = &PPU.line_log;
 
-    if (GB_get_status_mode(gb) == 3 && PPU.next_cycles >= 12 && PPU.next_cycles <= 172)
+    // only writes that happen mid-line need to be logged, everything
+    // else is already in IO by the time the line is rendered.
+    if (GB_is_system_gbc(gb) || !GB_is_lcd_enabled(gb) || GB_get_status_mode(gb) != STATUS_MODE_TRANSFER)
     {
-        const uint8_t index = (172 - PPU.next_cycles) / 8;
+        return;
+    }
+
+    // this is lazily done on the first write so that lines without any
+    // writes don't pay for it.
+    if (log->count == 0)
+    {
+        log->start = (struct GB_PpuLineRegs)
+        {
+            .lcdc = IO_LCDC,
+            .scy = IO_SCY,
+            .scx = IO_SCX,
+            .bgp = IO_BGP,
+            .obp0 = IO_OBP0,
+            .obp1 = IO_OBP1,
+            .wx = IO_WX,
+        };
+    }
 
-        cache[index].used = true;
-        cache[index].pal = value;
+    if (UNLIKELY(log->count == GB_PPU_LINE_LOG_MAX))
+    {
+        GB_log("[PPU-WARN] line log full, dropping write to 0x%02X\n", reg);
+        return;
     }
+
+    const int16_t x = 172 - PPU.next_cycles;
+
+    log->entries[log->count++] = (struct GB_PpuLineWrite)
+    {
+        .x = (uint8_t)(x < 0 ? 0 : MIN(x, GB_SCREEN_WIDTH)),
+        .reg = reg,
+        .value = value,
+    };
+}
+
+void DMG_log_reg_write(struct GB_Core* gb, uint8_t reg, uint8_t value)
+{
+    dmg_log_reg_write(gb, reg, value);
 }
 
 void on_bgp_write(struct GB_Core* gb, uint8_t value)
 {
     if (!GB_is_system_gbc(gb))
     {
-        on_dmg_palette_write(gb, DMG_PPU.bg_cache, &PPU.dirty_bg[0], IO_BGP, value);
+        dmg_log_reg_write(gb, 0x47, value);
+        PPU.dirty_bg[0] |= IO_BGP != value;
     }
 
     IO_BGP = value;
@@ -77,7 +113,8 @@ void on_obp0_write(struct GB_Core* gb, uint8_t value)
 {
     if (!GB_is_system_gbc(gb))
     {
-        on_dmg_palette_write(gb, DMG_PPU.obj_cache[0], &PPU.dirty_obj[0], IO_OBP0, value);
+        dmg_log_reg_write(gb, 0x48, value);
+        PPU.dirty_obj[0] |= IO_OBP0 != value;
     }
 
     IO_OBP0 = value;
@@ -87,7 +124,8 @@ void on_obp1_write(struct GB_Core* gb, uint8_t value)
 {
     if (!GB_is_system_gbc(gb))
     {
-        on_dmg_palette_write(gb, DMG_PPU.obj_cache[1], &PPU.dirty_obj[1], IO_OBP1, value);
+        dmg_log_reg_write(gb, 0x49, value);
+        PPU.dirty_obj[1] |= IO_OBP1 != value;
     }
 
     IO_OBP1 = value;
@@ -126,11 +164,10 @@ static FORCE_INLINE struct DMG_SpriteAttribute dmg_get_sprite_attr(const uint8_t
     };
 }
 
-static inline struct DMG_Sprites dmg_sprite_fetch(const struct GB_Core* gb)
+static inline struct DMG_Sprites dmg_sprite_fetch(const struct GB_Core* gb, const uint8_t sprite_size)
 {
     struct DMG_Sprites sprites = {0};
 
-    const uint8_t sprite_size = GB_get_sprite_size(gb);
     const uint8_t ly = IO_LY;
 
     for (size_t i = 0; i < ARRAY_SIZE(gb->ppu.oam); i += 4)
@@ -192,137 +229,103 @@ static inline struct DMG_Sprites dmg_sprite_fetch(const struct GB_Core* gb)
     return sprites;
 }
 
-static void render_bg_dmg(struct GB_Core* gb, uint32_t pixels[160], struct DmgPrioBuf* prio_buf)
+static FORCE_INLINE uint16_t dmg_get_tile_offset(const uint8_t lcdc, const uint8_t tile_num, const uint8_t sub_tile_y)
 {
-    const uint8_t scanline = IO_LY;
-    const uint8_t base_tile_x = IO_SCX >> 3;
-    const uint8_t sub_tile_x = (IO_SCX & 7);
-    const uint8_t pixel_y = (scanline + IO_SCY);
-    const uint8_t tile_y = pixel_y >> 3;
+    if (lcdc & 0x10)
+    {
+        return 0x8000 + (tile_num * 16) + (sub_tile_y << 1);
+    }
+    else
+    {
+        return 0x9000 + (((int8_t)tile_num) * 16) + (sub_tile_y << 1);
+    }
+}
+
+static void render_bg_dmg(struct GB_Core* gb, const struct DmgSpan* span, uint32_t pixels[160], struct DmgPrioBuf* prio_buf)
+{
+    const uint8_t pixel_y = (IO_LY + span->regs.scy);
     const uint8_t sub_tile_y = (pixel_y & 7);
+    const uint16_t map_select = (span->regs.lcdc & 0x08) ? 0x9C00 : 0x9800;
 
     const uint8_t* bit = PIXEL_BIT_SHRINK;
     /* due how internally the array is represented when NOT built with gbc */
     /* support, this needed changing to silence gcc array-bounds */
-    const uint8_t* vram_map = ((const uint8_t*)gb->ppu.vram) + ((GB_get_bg_map_select(gb) + (tile_y * 32)) & 0x1FFF);
-
-    for (uint8_t tile_x = 0; tile_x <= 20; ++tile_x)
-    {
-        const int16_t x_index_offset = (tile_x * 8) - sub_tile_x;
+    const uint8_t* vram_map = ((const uint8_t*)gb->ppu.vram) + ((map_select + ((pixel_y >> 3) * 32)) & 0x1FFF);
 
-        // rest of the tiles won't be drawn onscreen
-        // this only happens if sub_tile_x == 0
-        if (x_index_offset >= GB_SCREEN_WIDTH)
-        {
-            break;
-        }
+    uint8_t x_index = span->start;
 
-        const uint8_t map_x = (base_tile_x + tile_x) & 31;
+    while (x_index < span->end)
+    {
+        const uint8_t pixel_x = x_index + span->regs.scx;
 
-        const uint8_t tile_num = vram_map[map_x];
-        const uint16_t offset = GB_get_tile_offset(gb, tile_num, sub_tile_y);
+        const uint8_t tile_num = vram_map[pixel_x >> 3];
+        const uint16_t offset = dmg_get_tile_offset(span->regs.lcdc, tile_num, sub_tile_y);
 
         const uint8_t byte_a = GB_vram_read(gb, offset + 0, 0);
         const uint8_t byte_b = GB_vram_read(gb, offset + 1, 0);
 
-        for (uint8_t x = 0; x < 8; ++x)
+        // the first tile may be partially scrolled off the left
+        for (uint8_t x = pixel_x & 7; x < 8 && x_index < span->end; ++x, ++x_index)
         {
-            const int16_t x_index = x_index_offset + x;
-
-            if (x_index >= GB_SCREEN_WIDTH)
-            {
-                break;
-            }
-
-            if (x_index < 0)
-            {
-                continue;
-            }
-
             const uint8_t colour_id = ((!!(byte_b & bit[x])) << 1) | (!!(byte_a & bit[x]));
 
             prio_buf->colour_id[x_index] = colour_id;
-
-            const uint32_t colour = DMG_PPU.bg_colours[x_index>>3][colour_id];
-
-            pixels[x_index] = colour;
+            pixels[x_index] = span->bg_colours[colour_id];
         }
     }
 }
 
-static void render_win_dmg(struct GB_Core* gb, uint32_t pixels[160], struct DmgPrioBuf* prio_buf)
+static bool render_win_dmg(struct GB_Core* gb, const struct DmgSpan* span, uint32_t pixels[160], struct DmgPrioBuf* prio_buf)
 {
-    const uint8_t base_tile_x = 20 - (IO_WX >> 3);
-    const int16_t sub_tile_x = IO_WX - 7;
+    // can be negative if WX < 7, in which case the window is shifted left
+    const int16_t win_start = span->regs.wx - 7;
     const uint8_t pixel_y = gb->ppu.window_line;
-    const uint8_t tile_y = pixel_y >> 3;
     const uint8_t sub_tile_y = (pixel_y & 7);
+    const uint16_t map_select = (span->regs.lcdc & 0x40) ? 0x9C00 : 0x9800;
 
-    bool did_draw = false;
+    if (win_start >= span->end)
+    {
+        return false;
+    }
 
     const uint8_t* bit = PIXEL_BIT_SHRINK;
-    const uint8_t* vram_map = ((const uint8_t*)gb->ppu.vram) + ((GB_get_win_map_select(gb) + (tile_y * 32)) & 0x1FFF);
+    const uint8_t* vram_map = ((const uint8_t*)gb->ppu.vram) + ((map_select + ((pixel_y >> 3) * 32)) & 0x1FFF);
 
-    for (uint8_t tile_x = 0; tile_x <= base_tile_x; ++tile_x)
-    {
-        const uint8_t x_index_offset = (tile_x * 8) + sub_tile_x;
+    uint8_t x_index = MAX(win_start, span->start);
 
-        // skip this one as it'll never be drawn
-        if (x_index_offset >= GB_SCREEN_WIDTH && x_index_offset <= 255-7)
-        {
-            continue;
-        }
+    while (x_index < span->end)
+    {
+        const uint8_t pixel_x = x_index - win_start;
 
-        const uint8_t tile_num = vram_map[tile_x];
-        const uint16_t offset = GB_get_tile_offset(gb, tile_num, sub_tile_y);
+        const uint8_t tile_num = vram_map[pixel_x >> 3];
+        const uint16_t offset = dmg_get_tile_offset(span->regs.lcdc, tile_num, sub_tile_y);
 
         const uint8_t byte_a = GB_vram_read(gb, offset + 0, 0);
         const uint8_t byte_b = GB_vram_read(gb, offset + 1, 0);
 
-        for (uint8_t x = 0; x < 8; ++x)
+        for (uint8_t x = pixel_x & 7; x < 8 && x_index < span->end; ++x, ++x_index)
         {
-            const uint8_t x_index = x_index_offset + x;
-
-            if (x_index >= GB_SCREEN_WIDTH)
-            {
-                continue; // we don't break because the screen scrolls in from the right
-            }
-
-            did_draw |= true;
-
             const uint8_t colour_id = ((!!(byte_b & bit[x])) << 1) | (!!(byte_a & bit[x]));
 
             prio_buf->colour_id[x_index] = colour_id;
-
-            const uint32_t colour = DMG_PPU.bg_colours[x_index>>3][colour_id];
-
-            pixels[x_index] = colour;
+            pixels[x_index] = span->bg_colours[colour_id];
         }
     }
 
-    if (did_draw)
-    {
-        ++gb->ppu.window_line;
-    }
+    return true;
 }
 
-static void render_obj_dmg(struct GB_Core* gb, uint32_t pixels[160], const struct DmgPrioBuf* prio_buf)
+static void render_obj_dmg(struct GB_Core* gb, const struct DmgSpan* span, const struct DMG_Sprites* sprites, uint8_t sprite_size, uint32_t pixels[160], const struct DmgPrioBuf* prio_buf, bool oam_priority[160])
 {
     const uint8_t scanline = IO_LY;
-    const uint8_t sprite_size = GB_get_sprite_size(gb);
-
-    /* keep track of when an oam entry has already been written. */
-    bool oam_priority[GB_SCREEN_WIDTH] = {0};
 
-    const struct DMG_Sprites sprites = dmg_sprite_fetch(gb);
-
-    for (uint8_t i = 0; i < sprites.count; ++i)
+    for (uint8_t i = 0; i < sprites->count; ++i)
     {
-        const struct DMG_Sprite* sprite = &sprites.sprite[i];
+        const struct DMG_Sprite* sprite = &sprites->sprite[i];
 
-        /* check if the sprite has a chance of being on screen */
+        /* check if the sprite has a chance of being in this span */
         /* + 8 because thats the width of each sprite (8 pixels) */
-        if (sprite->x == -8 || sprite->x >= GB_SCREEN_WIDTH)
+        if (sprite->x == -8 || sprite->x >= span->end)
         {
             continue;
         }
@@ -336,19 +339,20 @@ static void render_obj_dmg(struct GB_Core* gb, uint32_t pixels[160], const struc
         const uint8_t byte_b = GB_vram_read(gb, offset + 1, 0);
 
         const uint8_t* bit = sprite->a.xflip ? PIXEL_BIT_GROW : PIXEL_BIT_SHRINK;
+        const uint32_t* colours = span->obj_colours[sprite->a.pal];
 
         for (int8_t x = 0; x < 8; ++x)
         {
             const int16_t x_index = sprite->x + x;
 
-            /* sprite is offscreen, exit loop now */
-            if (x_index >= GB_SCREEN_WIDTH)
+            /* sprite is outside the span, exit loop now */
+            if (x_index >= span->end)
             {
                 break;
             }
 
             /* ensure that we are in bounds */
-            if (x_index < 0)
+            if (x_index < span->start)
             {
                 continue;
             }
@@ -374,39 +378,142 @@ static void render_obj_dmg(struct GB_Core* gb, uint32_t pixels[160], const struc
             /* keep track of the sprite pixel that was written (so we don't overlap it!) */
             oam_priority[x_index] = true;
 
-            const uint32_t colour = DMG_PPU.obj_colours[sprite->a.pal][x_index>>3][colour_id];
+            pixels[x_index] = colours[colour_id];
+        }
+    }
+}
 
-            pixels[x_index] = colour;
+// returns true if the window was drawn in this span
+static bool render_span_dmg(struct GB_Core* gb, const struct DmgSpan* span, const struct DMG_Sprites* sprites, uint8_t sprite_size, uint32_t pixels[160], struct DmgPrioBuf* prio_buf, bool oam_priority[160])
+{
+    bool did_draw_win = false;
+
+    if (LIKELY(span->regs.lcdc & 0x01))
+    {
+        render_bg_dmg(gb, span, pixels, prio_buf);
+
+        /* WX=0..166, WY=0..143 */
+        if ((span->regs.lcdc & 0x20) && (span->regs.wx <= 166) && (IO_WY <= 143) && (IO_WY <= IO_LY))
+        {
+            did_draw_win = render_win_dmg(gb, span, pixels, prio_buf);
+        }
+
+        if (LIKELY(span->regs.lcdc & 0x02))
+        {
+            render_obj_dmg(gb, span, sprites, sprite_size, pixels, prio_buf, oam_priority);
         }
     }
+
+    return did_draw_win;
 }
 
-void DMG_render_scanline(struct GB_Core* gb)
+static FORCE_INLINE void dmg_apply_line_write(struct GB_PpuLineRegs* regs, const struct GB_PpuLineWrite* write)
 {
-    struct DmgPrioBuf prio_buf = {0};
-    uint32_t scanline[160] = {0};
+    switch (write->reg)
+    {
+        case 0x40: regs->lcdc = write->value; break;
+        case 0x42: regs->scy = write->value; break;
+        case 0x43: regs->scx = write->value; break;
+        case 0x47: regs->bgp = write->value; break;
+        case 0x48: regs->obp0 = write->value; break;
+        case 0x49: regs->obp1 = write->value; break;
+        case 0x4B: regs->wx = write->value; break;
+    }
+}
+
+// slow path, the line had writes during mode 3 so it's drawn in spans,
+// each span using the register values that were set at that point.
+static bool render_logged_line_dmg(struct GB_Core* gb, const struct DMG_Sprites* sprites, uint8_t sprite_size, uint32_t pixels[160], struct DmgPrioBuf* prio_buf, bool oam_priority[160])
+{
+    const struct GB_PpuLineLog* log = &PPU.line_log;
+
+    uint32_t bg_colours[4];
+    uint32_t obj_colours[2][4];
 
-    // update the DMG colour palettes
-    dmg_update_colours(DMG_PPU.bg_cache, DMG_PPU.bg_colours, &PPU.dirty_bg[0], gb->palette.BG, IO_BGP);
-    dmg_update_colours(DMG_PPU.obj_cache[0], DMG_PPU.obj_colours[0], &PPU.dirty_obj[0], gb->palette.OBJ0, IO_OBP0);
-    dmg_update_colours(DMG_PPU.obj_cache[1], DMG_PPU.obj_colours[1], &PPU.dirty_obj[1], gb->palette.OBJ1, IO_OBP1);
+    struct DmgSpan span =
+    {
+        .regs = log->start,
+        .bg_colours = bg_colours,
+        .obj_colours = { obj_colours[0], obj_colours[1] },
+    };
 
-    if (LIKELY(GB_is_bg_enabled(gb)))
+    bool did_draw_win = false;
+
+    for (uint8_t i = 0; i <= log->count; ++i)
     {
-        render_bg_dmg(gb, scanline, &prio_buf);
+        span.end = i < log->count ? log->entries[i].x : GB_SCREEN_WIDTH;
 
-        /* WX=0..166, WY=0..143 */
-        if ((GB_is_win_enabled(gb)) && (IO_WX <= 166) && (IO_WY <= 143) && (IO_WY <= IO_LY))
+        if (span.end > span.start)
         {
-            render_win_dmg(gb, scanline, &prio_buf);
+            dmg_build_colours(bg_colours, gb->palette.BG, span.regs.bgp);
+            dmg_build_colours(obj_colours[0], gb->palette.OBJ0, span.regs.obp0);
+            dmg_build_colours(obj_colours[1], gb->palette.OBJ1, span.regs.obp1);
+
+            did_draw_win |= render_span_dmg(gb, &span, sprites, sprite_size, pixels, prio_buf, oam_priority);
+            span.start = span.end;
         }
 
-        if (LIKELY(GB_is_obj_enabled(gb)))
+        if (i < log->count)
         {
-            render_obj_dmg(gb, scanline, &prio_buf);
+            dmg_apply_line_write(&span.regs, &log->entries[i]);
         }
     }
 
+    return did_draw_win;
+}
+
+void DMG_render_scanline(struct GB_Core* gb)
+{
+    struct DmgPrioBuf prio_buf = {0};
+    uint32_t scanline[160] = {0};
+    /* keep track of when an oam entry has already been written. */
+    bool oam_priority[GB_SCREEN_WIDTH] = {0};
+
+    const bool has_writes = PPU.line_log.count > 0;
+    const uint8_t lcdc = has_writes ? PPU.line_log.start.lcdc : IO_LCDC;
+    const uint8_t sprite_size = (lcdc & 0x04) ? 16 : 8;
+    const struct DMG_Sprites sprites = dmg_sprite_fetch(gb, sprite_size);
+    bool did_draw_win = false;
+
+    // update the DMG colour palettes, this uses the final values of the
+    // line, which are what the next line starts with.
+    dmg_update_colours(DMG_PPU.bg_colours, &PPU.dirty_bg[0], gb->palette.BG, IO_BGP);
+    dmg_update_colours(DMG_PPU.obj_colours[0], &PPU.dirty_obj[0], gb->palette.OBJ0, IO_OBP0);
+    dmg_update_colours(DMG_PPU.obj_colours[1], &PPU.dirty_obj[1], gb->palette.OBJ1, IO_OBP1);
+
+    if (LIKELY(!has_writes))
+    {
+        // fast path, nothing changed mid-line so draw it in one go.
+        const struct DmgSpan span =
+        {
+            .regs =
+            {
+                .lcdc = IO_LCDC,
+                .scy = IO_SCY,
+                .scx = IO_SCX,
+                .bgp = IO_BGP,
+                .obp0 = IO_OBP0,
+                .obp1 = IO_OBP1,
+                .wx = IO_WX,
+            },
+            .bg_colours = DMG_PPU.bg_colours,
+            .obj_colours = { DMG_PPU.obj_colours[0], DMG_PPU.obj_colours[1] },
+            .start = 0,
+            .end = GB_SCREEN_WIDTH,
+        };
+
+        did_draw_win = render_span_dmg(gb, &span, &sprites, sprite_size, scanline, &prio_buf, oam_priority);
+    }
+    else
+    {
+        did_draw_win = render_logged_line_dmg(gb, &sprites, sprite_size, scanline, &prio_buf, oam_priority);
+    }
+
+    if (did_draw_win)
+    {
+        ++gb->ppu.window_line;
+    }
+
     write_scanline_to_frame(gb, scanline);
 }
 
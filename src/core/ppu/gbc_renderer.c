@@ -148,6 +148,7 @@ static FORCE_INLINE uint8_t hdma_read(const struct GB_Core* gb, const uint16_t a
 static FORCE_INLINE void hdma_write(struct GB_Core* gb, const uint16_t addr, const uint8_t value)
 {
     PPU.vram[IO_VBK][addr & 0x1FFF] = value;
+    GB_mark_page_dirty(gb, GB_PAGE_VRAM + IO_VBK * 0x20 + ((addr >> 8) & 0x1F));
 }
 
 void perform_hdma(struct GB_Core* gb)
@@ -221,6 +221,7 @@ void GB_change_status_mode(struct GB_Core* gb, const uint8_t new_mode)
 
         case STATUS_MODE_TRANSFER:
             gb->ppu.next_cycles += 172;
+            gb->ppu.line_log.count = 0;
             break;
     }
 }
@@ -269,12 +270,15 @@ static void on_lcd_enable(struct GB_Core* gb)
 
     gb->ppu.next_cycles = 0;
     gb->ppu.stat_line = false;
+    gb->ppu.line_log.count = 0;
     GB_set_status_mode(gb, STATUS_MODE_TRANSFER);
     GB_compare_LYC(gb);
 }
 
 void GB_on_lcdc_write(struct GB_Core* gb, const uint8_t value)
 {
+    DMG_log_reg_write(gb, 0x40, value);
+
     // check if the game wants to disable the ppu
     if (GB_is_lcd_enabled(gb) && (value & 0x80) == 0)
     {
@@ -387,6 +391,8 @@ void GB_DMA(struct GB_Core* gb)
         // mbc2-ram!!!
         memcpy(gb->ppu.oam, entry.ptr + ((IO_DMA & 0xF) << 8), sizeof(gb->ppu.oam));
     }
+
+    GB_mark_page_dirty(gb, GB_PAGE_OAM);
 }
 
 bool GB_is_render_layer_enabled(const struct GB_Core* gb, enum GB_RenderLayerConfig want)
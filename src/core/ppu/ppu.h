@@ -31,6 +31,8 @@ GB_FORCE_INLINE uint8_t GB_get_sprite_size(const struct GB_Core* gb);
 GB_FORCE_INLINE void on_bgp_write(struct GB_Core* gb, uint8_t value);
 GB_FORCE_INLINE void on_obp0_write(struct GB_Core* gb, uint8_t value);
 GB_FORCE_INLINE void on_obp1_write(struct GB_Core* gb, uint8_t value);
+// logs writes to SCX/SCY/WX/LCDC/palettes that happen during mode 3.
+GB_FORCE_INLINE void DMG_log_reg_write(struct GB_Core* gb, uint8_t reg, uint8_t value);
 
 GB_FORCE_INLINE void write_scanline_to_frame(struct GB_Core* gb, const uint32_t scanline[160]);
 
@@ -0,0 +1,88 @@
+#ifndef GB_BLIP_TABLE_H
+#define GB_BLIP_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+
+// band-limited impulse used by the apu to add amplitude deltas.
+// each row is the impulse shifted by (phase / 64) of a sample.
+// this is a blackman windowed sinc, cutoff at 0.45 of the output rate,
+// each row is normalised to sum to exactly 1 << 15 so that the
+// integrated output never drifts.
+static const int16_t BLIP_STEP_TABLE[64][16] =
+{
+    {     18,   -110,    359,   -843,   1561,  -2371,   3025,  29490,   3025,  -2371,   1561,   -843,    359,   -110,     18,      0 },
+    {     18,   -109,    353,   -820,   1492,  -2199,   2566,  29481,   3495,  -2543,   1628,   -866,    364,   -110,     18,      0 },
+    {     17,   -108,    347,   -795,   1421,  -2025,   2117,  29452,   3974,  -2714,   1693,   -887,    369,   -111,     18,      0 },
+    {     17,   -107,    340,   -769,   1349,  -1852,   1679,  29400,   4463,  -2883,   1757,   -906,    373,   -111,     18,      0 },
+    {     17,   -105,    332,   -742,   1276,  -1679,   1252,  29332,   4960,  -3051,   1818,   -925,    376,   -110,     17,      0 },
+    {     17,   -104,    324,   -715,   1202,  -1507,    837,  29242,   5467,  -3215,   1876,   -941,    378,   -110,     17,      0 },
+    {     16,   -102,    315,   -686,   1128,  -1335,    434,  29131,   5981,  -3378,   1932,   -956,    380,   -109,     17,      0 },
+    {     16,   -100,    306,   -657,   1052,  -1165,     43,  29003,   6502,  -3537,   1986,   -970,    381,   -108,     16,      0 },
+    {     16,    -98,    297,   -627,    977,   -997,   -336,  28853,   7031,  -3693,   2036,   -982,    381,   -106,     16,      0 },
+    {     15,    -95,    287,   -597,    900,   -830,   -702,  28688,   7565,  -3845,   2083,   -991,    380,   -105,     15,      0 },
+    {     15,    -93,    277,   -566,    824,   -665,  -1055,  28499,   8106,  -3992,   2127,   -999,    378,   -103,     15,      0 },
+    {     14,    -90,    267,   -535,    748,   -503,  -1395,  28293,   8652,  -4135,   2167,  -1005,    376,   -100,     14,      0 },
+    {     14,    -87,    256,   -503,    672,   -343,  -1721,  28067,   9203,  -4273,   2204,  -1009,    372,    -97,     13,      0 },
+    {     13,    -85,    245,   -471,    597,   -187,  -2034,  27825,   9759,  -4405,   2237,  -1011,    367,    -94,     12,      0 },
+    {     13,    -82,    234,   -439,    522,    -34,  -2334,  27565,  10317,  -4531,   2266,  -1011,    362,    -91,     11,      0 },
+    {     12,    -79,    223,   -407,    447,    116,  -2619,  27287,  10879,  -4652,   2291,  -1008,    355,    -87,     10,      0 },
+    {     12,    -76,    211,   -375,    374,    262,  -2891,  26992,  11444,  -4765,   2311,  -1004,    348,    -83,      8,      0 },
+    {     11,    -73,    200,   -343,    301,    405,  -3149,  26678,  12010,  -4871,   2328,   -997,    339,    -78,      7,      0 },
+    {     10,    -69,    188,   -311,    229,    543,  -3394,  26350,  12577,  -4970,   2339,   -987,    330,    -73,      6,      0 },
+    {     10,    -66,    177,   -279,    159,    677,  -3624,  26005,  13145,  -5061,   2346,   -976,    319,    -68,      4,      0 },
+    {      9,    -63,    165,   -248,     90,    807,  -3840,  25646,  13712,  -5144,   2348,   -962,    308,    -62,      2,      0 },
+    {      9,    -60,    153,   -217,     22,    932,  -4042,  25268,  14279,  -5218,   2346,   -945,    295,    -56,      1,      1 },
+    {      8,    -56,    142,   -186,    -44,   1052,  -4231,  24877,  14845,  -5283,   2338,   -926,    282,    -50,     -1,      1 },
+    {      8,    -53,    130,   -156,   -108,   1167,  -4405,  24473,  15409,  -5339,   2325,   -905,    267,    -43,     -3,      1 },
+    {      7,    -50,    119,   -126,   -171,   1277,  -4566,  24057,  15970,  -5386,   2307,   -881,    251,    -36,     -5,      1 },
+    {      7,    -47,    107,    -96,   -232,   1382,  -4713,  23625,  16527,  -5422,   2284,   -854,    235,    -28,     -8,      1 },
+    {      6,    -44,     96,    -68,   -291,   1482,  -4846,  23182,  17081,  -5448,   2255,   -825,    217,    -21,    -10,      2 },
+    {      6,    -40,     85,    -39,   -348,   1577,  -4966,  22723,  17630,  -5463,   2221,   -794,    198,    -12,    -12,      2 },
+    {      5,    -37,     74,    -12,   -403,   1666,  -5072,  22257,  18174,  -5467,   2182,   -760,    178,     -4,    -15,      2 },
+    {      5,    -34,     64,     15,   -456,   1750,  -5165,  21777,  18711,  -5460,   2137,   -724,    158,      5,    -17,      2 },
+    {      4,    -31,     53,     41,   -506,   1828,  -5246,  21289,  19243,  -5441,   2086,   -685,    136,     14,    -20,      3 },
+    {      4,    -28,     43,     66,   -554,   1901,  -5313,  20790,  19767,  -5411,   2030,   -644,    114,     23,    -23,      3 },
+    {      3,    -25,     33,     90,   -600,   1968,  -5368,  20283,  20283,  -5368,   1968,   -600,     90,     33,    -25,      3 },
+    {      3,    -23,     23,    114,   -644,   2030,  -5411,  19767,  20790,  -5313,   1901,   -554,     66,     43,    -28,      4 },
+    {      3,    -20,     14,    136,   -685,   2086,  -5441,  19243,  21289,  -5246,   1828,   -506,     41,     53,    -31,      4 },
+    {      2,    -17,      5,    158,   -724,   2137,  -5460,  18711,  21777,  -5165,   1750,   -456,     15,     64,    -34,      5 },
+    {      2,    -15,     -4,    178,   -760,   2182,  -5467,  18174,  22257,  -5072,   1666,   -403,    -12,     74,    -37,      5 },
+    {      2,    -12,    -12,    198,   -794,   2221,  -5463,  17630,  22723,  -4966,   1577,   -348,    -39,     85,    -40,      6 },
+    {      2,    -10,    -21,    217,   -825,   2255,  -5448,  17081,  23182,  -4846,   1482,   -291,    -68,     96,    -44,      6 },
+    {      1,     -8,    -28,    235,   -854,   2284,  -5422,  16527,  23625,  -4713,   1382,   -232,    -96,    107,    -47,      7 },
+    {      1,     -5,    -36,    251,   -881,   2307,  -5386,  15970,  24057,  -4566,   1277,   -171,   -126,    119,    -50,      7 },
+    {      1,     -3,    -43,    267,   -905,   2325,  -5339,  15409,  24473,  -4405,   1167,   -108,   -156,    130,    -53,      8 },
+    {      1,     -1,    -50,    282,   -926,   2338,  -5283,  14845,  24877,  -4231,   1052,    -44,   -186,    142,    -56,      8 },
+    {      1,      1,    -56,    295,   -945,   2346,  -5218,  14279,  25268,  -4042,    932,     22,   -217,    153,    -60,      9 },
+    {      0,      2,    -62,    308,   -962,   2348,  -5144,  13712,  25646,  -3840,    807,     90,   -248,    165,    -63,      9 },
+    {      0,      4,    -68,    319,   -976,   2346,  -5061,  13145,  26005,  -3624,    677,    159,   -279,    177,    -66,     10 },
+    {      0,      6,    -73,    330,   -987,   2339,  -4970,  12577,  26350,  -3394,    543,    229,   -311,    188,    -69,     10 },
+    {      0,      7,    -78,    339,   -997,   2328,  -4871,  12010,  26678,  -3149,    405,    301,   -343,    200,    -73,     11 },
+    {      0,      8,    -83,    348,  -1004,   2311,  -4765,  11444,  26992,  -2891,    262,    374,   -375,    211,    -76,     12 },
+    {      0,     10,    -87,    355,  -1008,   2291,  -4652,  10879,  27287,  -2619,    116,    447,   -407,    223,    -79,     12 },
+    {      0,     11,    -91,    362,  -1011,   2266,  -4531,  10317,  27565,  -2334,    -34,    522,   -439,    234,    -82,     13 },
+    {      0,     12,    -94,    367,  -1011,   2237,  -4405,   9759,  27825,  -2034,   -187,    597,   -471,    245,    -85,     13 },
+    {      0,     13,    -97,    372,  -1009,   2204,  -4273,   9203,  28067,  -1721,   -343,    672,   -503,    256,    -87,     14 },
+    {      0,     14,   -100,    376,  -1005,   2167,  -4135,   8652,  28293,  -1395,   -503,    748,   -535,    267,    -90,     14 },
+    {      0,     15,   -103,    378,   -999,   2127,  -3992,   8106,  28499,  -1055,   -665,    824,   -566,    277,    -93,     15 },
+    {      0,     15,   -105,    380,   -991,   2083,  -3845,   7565,  28688,   -702,   -830,    900,   -597,    287,    -95,     15 },
+    {      0,     16,   -106,    381,   -982,   2036,  -3693,   7031,  28853,   -336,   -997,    977,   -627,    297,    -98,     16 },
+    {      0,     16,   -108,    381,   -970,   1986,  -3537,   6502,  29003,     43,  -1165,   1052,   -657,    306,   -100,     16 },
+    {      0,     17,   -109,    380,   -956,   1932,  -3378,   5981,  29131,    434,  -1335,   1128,   -686,    315,   -102,     16 },
+    {      0,     17,   -110,    378,   -941,   1876,  -3215,   5467,  29242,    837,  -1507,   1202,   -715,    324,   -104,     17 },
+    {      0,     17,   -110,    376,   -925,   1818,  -3051,   4960,  29332,   1252,  -1679,   1276,   -742,    332,   -105,     17 },
+    {      0,     18,   -111,    373,   -906,   1757,  -2883,   4463,  29400,   1679,  -1852,   1349,   -769,    340,   -107,     17 },
+    {      0,     18,   -111,    369,   -887,   1693,  -2714,   3974,  29452,   2117,  -2025,   1421,   -795,    347,   -108,     17 },
+    {      0,     18,   -110,    364,   -866,   1628,  -2543,   3495,  29481,   2566,  -2199,   1492,   -820,    353,   -109,     18 },
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GB_BLIP_TABLE_H
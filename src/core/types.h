@@ -39,7 +39,6 @@ struct GB_Rtc;
 struct GB_Sprite;
 struct GB_CartHeader;
 struct GB_Joypad;
-struct GB_ApuCallbackData;
 struct GB_Config;
 struct MBC_RomBankInfo;
 
@@ -53,6 +52,29 @@ enum
 
     GB_BOOTROM_SIZE = 0x100,
 
+    // size of the core-side sample buffer, in stereo frames.
+    // must be a power of 2.
+    GB_APU_BUFFER_FRAMES = 4096,
+
+    // number of output samples the band-limited synth can hold before
+    // they are read out, this is per side (left / right).
+    GB_APU_BLIP_SIZE = 1024,
+    // width of the band-limited step, see tables/blip_table.h
+    GB_APU_BLIP_TAPS = 16,
+    // a resample ratio of 1.0, see GB_set_apu_ratio().
+    GB_APU_RATIO_ONE = 0x10000,
+    // a master gain of 1.0, see GB_set_apu_gain().
+    GB_APU_GAIN_ONE = 0x100,
+    GB_APU_GAIN_MAX = GB_APU_GAIN_ONE * 4,
+
+    // max number of ppu register writes logged during a single mode 3.
+    // the fastest io write takes 8 cycles, so 172 / 8 = 21 writes.
+    GB_PPU_LINE_LOG_MAX = 24,
+
+    // max number of pending input events, see GB_queue_buttons().
+    // must be a power of 2.
+    GB_INPUT_QUEUE_SIZE = 64,
+
 #if 1
     GB_CPU_CYCLES = 4213440, // 456 * 154 (clocks per line * number of lines * 60 fps)
     GB_FRAME_CPU_CYCLES = 4213440 / 60, // 70224
@@ -86,6 +108,27 @@ enum GB_SaveSizes
     GB_SAVE_SIZE_MAX = GB_SAVE_SIZE_4,
 };
 
+// wram, vram, oam, hram and cart ram are split into pages, a page is
+// marked dirty when written to, see GB_get_dirty_pages().
+// these are the index of the first page of each.
+enum GB_Page
+{
+    GB_PAGE_SIZE = 0x100,
+
+    GB_PAGE_WRAM = 0,
+#if GBC_ENABLE
+    GB_PAGE_VRAM = GB_PAGE_WRAM + (0x1000 * 8) / GB_PAGE_SIZE,
+    GB_PAGE_OAM = GB_PAGE_VRAM + (0x2000 * 2) / GB_PAGE_SIZE,
+#else
+    GB_PAGE_VRAM = GB_PAGE_WRAM + (0x1000 * 2) / GB_PAGE_SIZE,
+    GB_PAGE_OAM = GB_PAGE_VRAM + (0x1000 * 2) / GB_PAGE_SIZE,
+#endif
+    GB_PAGE_HRAM = GB_PAGE_OAM + 1,
+    GB_PAGE_SRAM = GB_PAGE_HRAM + 1,
+
+    GB_PAGE_COUNT = GB_PAGE_SRAM + GB_SAVE_SIZE_MAX / GB_PAGE_SIZE,
+};
+
 enum GB_MbcType
 {
     GB_MbcType_0 = 1,
@@ -224,6 +267,15 @@ enum GB_RtcUpdateConfig
     GB_RTC_UPDATE_CONFIG_NONE,
 };
 
+enum GB_ApuResampler
+{
+    // band-limited steps using a windowed sinc, this is the default.
+    GB_APU_RESAMPLER_SINC,
+    // steps are linearly interpolated between 2 samples.
+    // cheaper, but aliases on high frequency channels.
+    GB_APU_RESAMPLER_LINEAR,
+};
+
 struct GB_PaletteEntry
 {
     uint32_t BG[4];
@@ -247,7 +299,8 @@ struct GB_Config
 };
 
 // user-set callbacks
-typedef void (*GB_apu_callback_t)(void* user, struct GB_ApuCallbackData* data);
+// [samples] is interleaved stereo, [frames] is the number of LR pairs.
+typedef void (*GB_apu_block_callback_t)(void* user, const int16_t* samples, uint32_t frames);
 typedef void (*GB_vblank_callback_t)(void* user);
 typedef void (*GB_hblank_callback_t)(void* user);
 typedef void (*GB_dma_callback_t)(void* user);
@@ -283,7 +336,7 @@ typedef void (*GB_write_callback_t)(void* user, uint16_t addr, uint8_t* v);
 
 struct GB_UserCallbacks
 {
-    GB_apu_callback_t       apu;
+    GB_apu_block_callback_t apu_block;
     GB_vblank_callback_t    vblank;
     GB_hblank_callback_t    hblank;
     GB_dma_callback_t       dma;
@@ -294,7 +347,7 @@ struct GB_UserCallbacks
     GB_colour_callback_t    colour;
     GB_rom_bank_callback_t  rom_bank;
 
-    void* user_apu;
+    void* user_apu_block;
     void* user_vblank;
     void* user_hblank;
     void* user_dma;
@@ -307,7 +360,20 @@ struct GB_UserCallbacks
 
     struct
     {
-        unsigned freq_reload;
+        // output samples per apu cycle, 32.32 fixed point.
+        // this is freq * ratio / GB_CPU_CYCLES.
+        uint64_t factor;
+        // max number of cycles to batch before syncing the apu.
+        uint32_t sync_cycles;
+        uint32_t block_frames;
+        uint32_t freq;
+        // 16.16 fixed point, see GB_APU_RATIO_ONE.
+        uint32_t ratio;
+        enum GB_ApuResampler resampler;
+        // 8.8 fixed point, see GB_APU_GAIN_ONE.
+        int32_t gain;
+        // the dc blocking filter leaks 1 / (1 << shift) per sample.
+        uint8_t hpf_shift;
     } apu_data;
 };
 
@@ -380,6 +446,23 @@ struct GB_Joypad
     uint8_t var;
 };
 
+struct GB_InputEvent
+{
+    // cycle relative to the start of the next GB_run().
+    uint32_t cycle;
+    // the buttons that are held down, GB_Button mask.
+    uint8_t buttons;
+};
+
+struct GB_InputQueue
+{
+    struct GB_InputEvent events[GB_INPUT_QUEUE_SIZE];
+    // cycle of the oldest event, UINT32_MAX if empty.
+    uint32_t next_cycle;
+    uint16_t read;
+    uint16_t count;
+};
+
 struct GB_Cpu
 {
     uint16_t cycles;
@@ -400,10 +483,32 @@ struct GB_Cpu
     bool _padding;
 };
 
-struct GB_PalCache
+// the registers that affect how a dmg scanline is rendered.
+struct GB_PpuLineRegs
+{
+    uint8_t lcdc;
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+    uint8_t wx;
+};
+
+struct GB_PpuLineWrite
 {
-    bool used;
-    uint8_t pal;
+    uint8_t x; // the pixel that the write takes effect from
+    uint8_t reg; // io reg, eg, 0x43 = SCX
+    uint8_t value;
+};
+
+// writes that happen during mode 3 are logged here so that the renderer
+// can draw the line span by span, rather than using the final values.
+struct GB_PpuLineLog
+{
+    struct GB_PpuLineRegs start; // the regs before the first logged write
+    struct GB_PpuLineWrite entries[GB_PPU_LINE_LOG_MAX];
+    uint8_t count;
 };
 
 struct GB_Ppu
@@ -447,14 +552,13 @@ struct GB_Ppu
 
         struct
         {
-            uint32_t bg_colours[20][4];
-            uint32_t obj_colours[2][20][4];
-
-            struct GB_PalCache bg_cache[20];
-            struct GB_PalCache obj_cache[2][20];
+            uint32_t bg_colours[4];
+            uint32_t obj_colours[2][4];
         } dmg;
     } system;
 
+    struct GB_PpuLineLog line_log;
+
     bool dirty_bg[8]; // only update the colours if the palette changes values.
     bool dirty_obj[8];
 };
@@ -501,6 +605,22 @@ struct GB_Cart
     uint8_t flags;
 };
 
+typedef void (*GB_mbc_write_t)(struct GB_Core* gb, uint16_t addr, uint8_t value);
+typedef struct MBC_RomBankInfo (*GB_mbc_get_rom_bank_t)(struct GB_Core* gb, uint8_t bank);
+typedef struct MBC_RamBankInfo (*GB_mbc_get_ram_bank_t)(struct GB_Core* gb);
+
+// resolved from the cart type (and the rom bank callback) when the
+// mbc is setup, so that the type isn't checked on every call.
+// this isn't part of the cart as that is saved in states.
+struct GB_MbcOps
+{
+    GB_mbc_write_t write;
+    GB_mbc_get_rom_bank_t get_rom_bank;
+    GB_mbc_get_ram_bank_t get_ram_bank;
+    // the cart's own get_rom_bank, used if the rom bank callback fails.
+    GB_mbc_get_rom_bank_t get_cart_rom_bank;
+};
+
 struct GB_Timer
 {
     int16_t next_cycles;
@@ -584,17 +704,12 @@ struct GB_ApuCh4
     bool disable_env;
 };
 
-struct GB_ApuCallbackData
-{
-    uint8_t ch1[2];
-    uint8_t ch2[2];
-    uint8_t ch3[2];
-    uint8_t ch4[2];
-};
-
 struct GB_Apu
 {
-    uint16_t next_sample_cycles;
+    // cycles that the channels have not been run for yet.
+    // the apu is only synced when this gets too big, or when
+    // something reads / writes to the apu.
+    uint32_t pending_cycles;
 
     struct GB_ApuCh1 ch1; // square 1
     struct GB_ApuCh2 ch2; // square 2
@@ -618,6 +733,29 @@ struct GB_mem
     uint8_t svbk;
 };
 
+// samples are pushed here, then either handed to the block callback
+// or pulled by the frontend with GB_read_apu_samples().
+struct GB_ApuBuffer
+{
+    int16_t samples[GB_APU_BUFFER_FRAMES * 2]; // interleaved stereo
+    // these are free running, masked on access.
+    uint32_t read;
+    uint32_t write;
+};
+
+// band-limited synth, each time a channel's output level changes, the
+// delta is added here at the cycle it happened. the output samples are
+// then read out in one go when the apu is synced.
+struct GB_ApuBlip
+{
+    // position of the current cycle in output samples, 32.32 fixed point.
+    uint64_t offset;
+    int32_t integrator[2];
+    // the last output level of each channel (left / right).
+    uint8_t level[4][2];
+    int32_t buf[2][GB_APU_BLIP_SIZE + GB_APU_BLIP_TAPS];
+};
+
 // TODO: this struct needs to be re-organised.
 // atm, i've just been dumping vars in here as one big container,
 // which works fine, though, it's starting to get messy, and could be
@@ -633,8 +771,10 @@ struct GB_Core
     struct GB_Ppu ppu;
     struct GB_Apu apu;
     struct GB_Cart cart;
+    struct GB_MbcOps mbc_ops;
     struct GB_Timer timer;
     struct GB_Joypad joypad;
+    struct GB_InputQueue input_queue;
 
     struct GB_PaletteEntry palette; /* default */
 
@@ -643,10 +783,12 @@ struct GB_Core
     struct GB_Config config;
 
     const uint8_t* rom;
-    size_t rom_size; // set by the user
+    size_t rom_size; // set by the user, only bank 0 for a partial rom
 
     uint8_t* ram;
     size_t ram_size; // set by the user
+    // set on every write to [ram], see GB_is_sram_dirty().
+    bool ram_dirty;
 
     void* pixels;
     uint32_t stride;
@@ -658,6 +800,12 @@ struct GB_Core
     bool is_master;
 
     struct GB_UserCallbacks callback;
+
+    struct GB_ApuBuffer apu_buffer;
+    struct GB_ApuBlip apu_blip;
+
+    // 1 bit per page, see enum GB_Page.
+    uint32_t dirty_pages[(GB_PAGE_COUNT + 31) / 32];
 };
 
 // i decided that the ram usage / statefile size is less important
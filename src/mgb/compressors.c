@@ -1,6 +1,11 @@
-#if 0
-#include <zstd.h>
-#include <lz4.h>
+#include "compressors.h"
+
+#ifdef HAS_ZSTD
+    #include <zstd.h>
+#endif
+#ifdef HAS_LZ4
+    #include <lz4.h>
+    #include <limits.h>
 #endif
 #include <zlib.h>
 #include <stdbool.h>
@@ -8,12 +13,6 @@
 #include <stddef.h>
 
 
-enum CompressMode
-{
-    CompressMode_DEFLATE,
-    CompressMode_INFLATE,
-};
-
 size_t Zlib_size(size_t src_size)
 {
     return compressBound(src_size);
@@ -22,7 +21,7 @@ size_t Zlib_size(size_t src_size)
 size_t Zlib(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode)
 {
     int result = 0;
-    uLongf dst_size_ = 0; // silence warn for ulong being different size to size_t
+    uLongf dst_size_ = dst_size; // silence warn for ulong being different size to size_t
 
     if (mode == CompressMode_DEFLATE)
     {
@@ -37,7 +36,7 @@ size_t Zlib(void* dst_data, size_t dst_size, const void* src_data, size_t src_si
     return result == Z_OK ? dst_size : (size_t) - 1;
 }
 
-#if 0
+#ifdef HAS_ZSTD
 size_t Zstd_size(size_t src_size)
 {
     return ZSTD_compressBound(src_size);
@@ -45,30 +44,94 @@ size_t Zstd_size(size_t src_size)
 
 size_t Zstd(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode)
 {
+    size_t result = 0;
+
     if (mode == CompressMode_DEFLATE)
     {
-        return ZSTD_compress(dst_data, dst_size, src_data, src_size, ZSTD_CLEVEL_DEFAULT);
+        result = ZSTD_compress(dst_data, dst_size, src_data, src_size, ZSTD_CLEVEL_DEFAULT);
     }
     else
     {
-        return ZSTD_decompress(dst_data, dst_size, src_data, src_size);
+        result = ZSTD_decompress(dst_data, dst_size, src_data, src_size);
     }
+
+    return ZSTD_isError(result) ? (size_t) - 1 : result;
 }
+#endif
 
+#ifdef HAS_LZ4
 size_t Lz4_size(size_t src_size)
 {
-    return LZ4_compressBound(src_size);
+    return src_size > LZ4_MAX_INPUT_SIZE ? 0 : (size_t)LZ4_compressBound((int)src_size);
 }
 
 size_t Lz4(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode)
 {
+    // lz4 uses int for sizes
+    const int dst_size_ = dst_size > INT_MAX ? INT_MAX : (int)dst_size;
+    int result = 0;
+
+    if (src_size > LZ4_MAX_INPUT_SIZE)
+    {
+        return (size_t) - 1;
+    }
+
     if (mode == CompressMode_DEFLATE)
     {
-        return LZ4_compress_default(src_data, dst_data, src_size, dst_size);
+        result = LZ4_compress_default(src_data, dst_data, (int)src_size, dst_size_);
     }
     else
     {
-        return LZ4_decompress_safe(src_data, dst_data, src_size, dst_size);
+        result = LZ4_decompress_safe(src_data, dst_data, (int)src_size, dst_size_);
     }
+
+    // compress returns 0 on error, decompress returns < 0
+    return result > 0 ? (size_t)result : (size_t) - 1;
 }
 #endif
+
+bool compressor_is_available(enum CompressorType type)
+{
+    return compressor_get(type) != NULL;
+}
+
+compressor_func_t compressor_get(enum CompressorType type)
+{
+    switch (type)
+    {
+        case CompressorType_ZLIB: return Zlib;
+    #ifdef HAS_ZSTD
+        case CompressorType_ZSTD: return Zstd;
+    #endif
+    #ifdef HAS_LZ4
+        case CompressorType_LZ4: return Lz4;
+    #endif
+        default: return NULL;
+    }
+}
+
+compressor_size_func_t compressor_get_size(enum CompressorType type)
+{
+    switch (type)
+    {
+        case CompressorType_ZLIB: return Zlib_size;
+    #ifdef HAS_ZSTD
+        case CompressorType_ZSTD: return Zstd_size;
+    #endif
+    #ifdef HAS_LZ4
+        case CompressorType_LZ4: return Lz4_size;
+    #endif
+        default: return NULL;
+    }
+}
+
+const char* compressor_get_name(enum CompressorType type)
+{
+    switch (type)
+    {
+        case CompressorType_ZLIB: return "zlib";
+        case CompressorType_ZSTD: return "zstd";
+        case CompressorType_LZ4: return "lz4";
+        default: return "unknown";
+    }
+}
@@ -4,17 +4,52 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
+enum CompressMode
+{
+    CompressMode_DEFLATE,
+    CompressMode_INFLATE,
+};
+
+// zstd and lz4 are optional, see MGB_ZSTD / MGB_LZ4 in cmake.
+// the value is stored in files, so don't reorder these.
+enum CompressorType
+{
+    CompressorType_ZLIB,
+    CompressorType_ZSTD,
+    CompressorType_LZ4,
+
+    CompressorType_COUNT,
+};
+
+// returns the compressed / decompressed size, or (size_t)-1 on error,
+// ie, if dst_size is too small.
+typedef size_t (*compressor_func_t)(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode);
+// returns the max compressed size of [src_size].
+typedef size_t (*compressor_size_func_t)(size_t src_size);
+
 size_t Zlib_size(size_t src_size);
 size_t Zlib(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode);
 
+#ifdef HAS_ZSTD
 size_t Zstd_size(size_t src_size);
 size_t Zstd(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode);
+#endif
 
+#ifdef HAS_LZ4
 size_t Lz4_size(size_t src_size);
 size_t Lz4(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode);
+#endif
+
+// returns false if mgb was built without it.
+bool compressor_is_available(enum CompressorType type);
+// these return NULL if not available.
+compressor_func_t compressor_get(enum CompressorType type);
+compressor_size_func_t compressor_get_size(enum CompressorType type);
+const char* compressor_get_name(enum CompressorType type);
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,11 @@
 #include "zrom.h"
 #include <lz4.h>
+#ifdef HAS_ZSTD
+    #include <zstd.h>
+#endif
+#if ZROM_SHARED_CACHE
+    #include <pthread.h>
+#endif
 #include <string.h>
 
 
@@ -17,23 +23,48 @@
     #define ZROM_log_fatal(...)
 #endif
 
+// the pool is shared with the prefetch worker, without it these do nothing.
+#if ZROM_PREFETCH
+    #define ZROM_lock(z) pthread_mutex_lock(&(z)->mutex)
+    #define ZROM_unlock(z) pthread_mutex_unlock(&(z)->mutex)
+#else
+    #define ZROM_lock(z)
+    #define ZROM_unlock(z)
+#endif
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 
-static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
+static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint16_t bank, int region);
 static bool mbc0_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
 static bool mbc1_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
 static bool mbc2_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
 static bool mbc3_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
 static bool mbc5_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank);
-static bool uncompress_bank_to_pool(struct Zrom* z, uint8_t bank);
+static bool uncompress_bank_to_pool(struct Zrom* z, uint16_t bank, int region);
+static const uint8_t* cache_get_bank(struct Zrom* z, uint16_t bank, int region);
 
 
-static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
+// the core asks for bank 0 when mapping 0x0000, otherwise it's 0x4000.
+static int get_region(uint8_t bank)
 {
-    if (!uncompress_bank_to_pool(z, bank))
+    return bank == 0 ? 0 : 1;
+}
+
+// returns NULL if the bank couldn't be loaded.
+static const uint8_t* get_bank(struct Zrom* z, uint16_t bank, int region)
+{
+    if (z->shared)
     {
-        return false;
+        return cache_get_bank(z, bank, region);
+    }
+
+    ZROM_lock(z);
+
+    if (!uncompress_bank_to_pool(z, bank, region))
+    {
+        ZROM_unlock(z);
+        return NULL;
     }
 
     const uint8_t* ptr = z->rom_data;
@@ -43,10 +74,31 @@ static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info
         ptr = z->pool + (z->pool_idx[bank - 1] * ZROM_BANK_SIZE);
     }
 
+    ZROM_unlock(z);
+
+    return ptr;
+}
+
+static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint16_t bank, int region)
+{
+    static const uint8_t ZROM_NO_BANK = 0xFF;
+    const uint8_t* ptr = get_bank(z, bank, region);
+    uint16_t mask = 0x0FFF;
+
+    // the core must never fallback to mapping the rom data itself, as only
+    // bank 0 of it is rom, so the bank reads as open bus instead.
+    if (!ptr)
+    {
+        ZROM_log_fatal("[ZROM] failed to load bank: %u\n", bank);
+        z->error = true;
+        ptr = &ZROM_NO_BANK;
+        mask = 0;
+    }
+
     for (size_t i = 0; i < sizeof(info->entries) / sizeof(info->entries[0]); ++i)
     {
-        info->entries[i].ptr = ptr + (0x1000 * i);
-        info->entries[i].mask = 0x0FFF;
+        info->entries[i].ptr = mask ? ptr + (0x1000 * i) : ptr;
+        info->entries[i].mask = mask;
     }
 
     return true;
@@ -54,109 +106,598 @@ static bool mbc_common_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info
 
 static bool mbc0_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
 {
-    return mbc_common_get_rom_bank(z, info, bank);
+    return mbc_common_get_rom_bank(z, info, bank, get_region(bank));
 }
 
-// NOTE: this is a stub, it wont work yet!!!!!!!!
 static bool mbc1_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
 {
-    (void)z; (void)info; (void)bank;
-    return false;
+    const struct GB_Cart* cart = &z->gb->cart;
+    uint16_t rom_bank = bank;
+
+    // same as the core, in mode 1 large carts can remap 0x0000
+    // to bank 0x20 / 0x40 / 0x60.
+    if (bank == 0 && cart->rom_bank_max > 18 && cart->bank_mode == 1)
+    {
+        rom_bank = (cart->rom_bank_hi << 5) % cart->rom_bank_max;
+    }
+
+    return mbc_common_get_rom_bank(z, info, rom_bank, get_region(bank));
 }
 
 static bool mbc2_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
 {
-    return mbc_common_get_rom_bank(z, info, bank);
+    return mbc_common_get_rom_bank(z, info, bank, get_region(bank));
 }
 
 static bool mbc3_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
 {
-    return mbc_common_get_rom_bank(z, info, bank);
+    return mbc_common_get_rom_bank(z, info, bank, get_region(bank));
 }
 
 static bool mbc5_get_rom_bank(struct Zrom* z, struct MBC_RomBankInfo* info, uint8_t bank)
 {
-    return mbc_common_get_rom_bank(z, info, bank);
+    return mbc_common_get_rom_bank(z, info, bank, get_region(bank));
+}
+
+// doesn't touch the pool state, so the worker calls this unlocked.
+// [thread] is 0 for the core and 1 for the worker.
+static bool decompress_bank(const struct Zrom* z, uint8_t bank, uint8_t* dst, int thread)
+{
+    const struct ZromBankEntry entry = z->entries[bank];
+
+    if (entry.flags & ZromEntryFlag_ZSTD)
+    {
+    #ifdef HAS_ZSTD
+        ZSTD_DCtx* dctx = z->zstd_dctx[thread];
+        size_t result = (size_t)-1;
+
+        if (!dctx)
+        {
+            ZROM_log_fatal("[ZROM] missing zstd dctx...\n");
+            return false;
+        }
+
+        if (entry.flags & ZromEntryFlag_DICT)
+        {
+            if (z->zstd_ddict)
+            {
+                result = ZSTD_decompress_usingDDict(dctx, dst, ZROM_BANK_SIZE, z->rom_data + entry.offset, entry.size, z->zstd_ddict);
+            }
+        }
+        else
+        {
+            result = ZSTD_decompressDCtx(dctx, dst, ZROM_BANK_SIZE, z->rom_data + entry.offset, entry.size);
+        }
+
+        if (ZSTD_isError(result))
+        {
+            ZROM_log_fatal("[ZROM] failed to decompress zstd bank: %u\n", bank);
+            return false;
+        }
+    #else
+        (void)thread;
+        ZROM_log_fatal("[ZROM] zstd bank but built without zstd...\n");
+        return false;
+    #endif
+    }
+    else if (entry.flags & ZromEntryFlag_COMPRESSED)
+    {
+        if (LZ4_decompress_safe((const char*)z->rom_data + entry.offset, (char*)dst, entry.size, ZROM_BANK_SIZE) < 0)
+        {
+            ZROM_log_fatal("[ZROM] failed to decompress bank: %u\n", bank);
+            return false;
+        }
+    }
+    else if (entry.flags & ZromEntryFlag_UNCOMPRESSED)
+    {
+        memcpy((char*)dst, (const char*)z->rom_data + entry.offset, entry.size);
+    }
+    else
+    {
+        ZROM_log_fatal("[ZROM] missing zrom flags...\n");
+        return false;
+    }
+
+    return true;
+}
+
+#if ZROM_SHARED_CACHE
+struct ZromCacheEntry
+{
+    uint64_t rom_hash;
+    uint64_t last_used;
+    uint16_t bank;
+    // zrom regions mapping this bank, including any waiting for it to load.
+    uint16_t refs;
+    bool used;
+    bool loading;
+};
+
+// shared by every zrom using zrom_init_shared(), entries with no refs are
+// evicted least recently used first.
+static struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t* pool;
+    size_t count;
+    // slots reserved by zrom_init_shared(), 2 per zrom.
+    size_t reserved;
+    uint64_t tick;
+    struct ZromCacheEntry entries[ZROM_CACHE_MAX_BANKS];
+} cache = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static bool cache_is_bank(int slot, uint64_t rom_hash, uint8_t bank)
+{
+    const struct ZromCacheEntry* e = &cache.entries[slot];
+    return e->used && e->rom_hash == rom_hash && e->bank == bank;
+}
+
+static int cache_find(const struct Zrom* z, uint8_t bank)
+{
+    const int hint = z->cache_hint[bank];
+
+    if (hint >= 0 && (size_t)hint < cache.count && cache_is_bank(hint, z->rom_hash, bank))
+    {
+        return hint;
+    }
+
+    for (size_t i = 0; i < cache.count; ++i)
+    {
+        if (cache_is_bank((int)i, z->rom_hash, bank))
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+// returns a free slot, or the least recently used one with no refs.
+static int cache_claim(void)
+{
+    int slot = -1;
+
+    for (size_t i = 0; i < cache.count; ++i)
+    {
+        const struct ZromCacheEntry* e = &cache.entries[i];
+
+        if (e->refs)
+        {
+            continue;
+        }
+
+        if (!e->used)
+        {
+            return (int)i;
+        }
+
+        if (slot < 0 || e->last_used < cache.entries[slot].last_used)
+        {
+            slot = (int)i;
+        }
+    }
+
+    return slot;
+}
+
+// returns the slot with a ref added, -1 on error.
+static int cache_acquire(struct Zrom* z, uint8_t bank)
+{
+    pthread_mutex_lock(&cache.mutex);
+
+    int slot = -1;
+    bool found = false;
+
+    for (;;)
+    {
+        slot = cache_find(z, bank);
+        found = slot >= 0;
+
+        if (found || (slot = cache_claim()) >= 0)
+        {
+            break;
+        }
+
+        // the reservations from zrom_init_shared() mean there's always
+        // a slot to claim, but wait for one to be released rather than fail.
+        ZROM_log("[ZROM] shared cache is full, waiting for bank: %u\n", bank);
+        pthread_cond_wait(&cache.cond, &cache.mutex);
+    }
+
+    struct ZromCacheEntry* e = &cache.entries[slot];
+
+    if (found)
+    {
+        e->refs++;
+
+        // another zrom is decompressing it
+        while (e->loading)
+        {
+            pthread_cond_wait(&cache.cond, &cache.mutex);
+        }
+
+        // which failed
+        if (!e->used)
+        {
+            e->refs--;
+            pthread_mutex_unlock(&cache.mutex);
+            return -1;
+        }
+    }
+    else
+    {
+        ZROM_log("\t[ZROM] NEW shared Bank! bank: %u slot: %d\n", bank, slot);
+
+        e->rom_hash = z->rom_hash;
+        e->bank = bank;
+        e->refs = 1;
+        e->used = true;
+        e->loading = true;
+
+        // don't block the other instances while decompressing,
+        // the ref stops the slot from being claimed.
+        pthread_mutex_unlock(&cache.mutex);
+        const bool result = decompress_bank(z, bank, cache.pool + (slot * ZROM_BANK_SIZE), 0);
+        pthread_mutex_lock(&cache.mutex);
+
+        e->loading = false;
+        pthread_cond_broadcast(&cache.cond);
+
+        if (!result)
+        {
+            e->used = false;
+            e->refs--;
+            pthread_mutex_unlock(&cache.mutex);
+            return -1;
+        }
+    }
+
+    e->last_used = ++cache.tick;
+    z->cache_hint[bank] = (int16_t)slot;
+
+    pthread_mutex_unlock(&cache.mutex);
+
+    return slot;
+}
+
+static void cache_release(struct Zrom* z, int region)
+{
+    if (z->cache_mapped[region] < 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&cache.mutex);
+
+    // wake anyone waiting for a slot to claim
+    if (!--cache.entries[z->cache_mapped[region]].refs)
+    {
+        pthread_cond_broadcast(&cache.cond);
+    }
+
+    pthread_mutex_unlock(&cache.mutex);
+
+    z->cache_mapped[region] = -1;
 }
 
-static bool uncompress_bank_to_pool(struct Zrom* z, uint8_t bank)
+static const uint8_t* cache_get_bank(struct Zrom* z, uint16_t bank, int region)
 {
     // bank zero is always uncompressed
     if (bank == 0)
     {
-        return true;
+        cache_release(z, region);
+        return z->rom_data;
     }
 
     --bank;
 
-    // if already compressed
-    if (z->slots[bank])
+    if (bank >= z->header.banks)
+    {
+        ZROM_log_fatal("[ZROM] bank out of range: %u\n", bank);
+        return NULL;
+    }
+
+    // release first so the old slot can be reused if the cache is full,
+    // if it's the same bank it'll be found again.
+    cache_release(z, region);
+
+    const int slot = cache_acquire(z, bank);
+
+    if (slot < 0)
+    {
+        return NULL;
+    }
+
+    z->cache_mapped[region] = (int16_t)slot;
+
+    return cache.pool + (slot * ZROM_BANK_SIZE);
+}
+
+static uint64_t hash_rom(const uint8_t* data, size_t size)
+{
+    // fnv-1a
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+#else
+static const uint8_t* cache_get_bank(struct Zrom* z, uint16_t bank, int region)
+{
+    (void)z; (void)bank; (void)region;
+    return NULL;
+}
+#endif // ZROM_SHARED_CACHE
+
+// moves the bank to the front of the lru, adding it if not found.
+static void touch_bank(struct Zrom* z, uint8_t bank)
+{
+    size_t i = 0;
+
+    while (i < z->last_used_count && z->last_used[i] != bank)
+    {
+        i++;
+    }
+
+    if (i == z->last_used_count)
+    {
+        z->last_used_count++;
+    }
+
+    memmove(z->last_used + 1, z->last_used, i);
+    z->last_used[0] = bank;
+
+#if ZROM_PREFETCH
+    z->prefetched[bank] = false;
+#endif
+}
+
+static bool is_mapped(const struct Zrom* z, uint8_t bank, int region)
+{
+    return z->mapped[region] == bank + 1;
+}
+
+// returns a free pool slot for [bank], evicting the least recently used
+// bank if needed. banks mapped in [keep] are never evicted (2 = both).
+// returns -1 if every slot is in use.
+static int claim_slot(struct Zrom* z, uint8_t bank, int keep)
+{
+    int slot = -1;
+
+    for (size_t i = 0; i < z->pool_count; ++i)
+    {
+        if (z->slot_bank[i] < 0)
+        {
+            slot = (int)i;
+            break;
+        }
+    }
+
+#if ZROM_PREFETCH
+    if (slot < 0 && keep == 2 && !z->recent_misses)
     {
+        return -1;
+    }
+#endif
 
-        for (size_t i = 0; i < z->last_used_count; ++i)
+    if (slot < 0)
+    {
+        for (size_t i = z->last_used_count; i-- > 0;)
         {
-            if (z->last_used[i] == bank)
+            const uint8_t old_bank = z->last_used[i];
+
+            if ((keep != 1 && is_mapped(z, old_bank, 0)) || (keep != 0 && is_mapped(z, old_bank, 1)))
+            {
+                continue;
+            }
+
+        #if ZROM_PREFETCH
+            // the worker only replaces banks that have been used,
+            // otherwise it would evict its own guesses.
+            if (keep == 2 && z->prefetched[old_bank])
             {
-                // break early if bank is in the first slot
-                if (i == 0)
-                {
-                    return true;
-                }
-
-                memmove(z->last_used + 1, z->last_used, i);
-                z->last_used[0] = bank;
-                return true;
+                continue;
             }
+        #endif
+
+            ZROM_log("\t[ZROM] bank miss! old_bank: %u new_bank: %u\n", old_bank, bank);
+
+            slot = z->pool_idx[old_bank];
+            z->slots[old_bank] = false;
+            memmove(z->last_used + i, z->last_used + i + 1, z->last_used_count - i - 1);
+            z->last_used_count--;
+            break;
         }
+    }
 
-        ZROM_log_fatal("[ZROM] this shouldn't be reachable!!!\n");
-        return true;
+    if (slot >= 0)
+    {
+        z->slot_bank[slot] = bank;
+        z->pool_idx[bank] = (uint8_t)slot;
     }
 
-    // if we uncompressed max banks already, then we need to
-    // uncompress this new bank over an old bank.
-    if (z->last_used_count == (z->pool_count))
+    return slot;
+}
+
+#if ZROM_PREFETCH
+static void queue_prefetch(struct Zrom* z, uint8_t bank)
+{
+    // the guesses are updated on every switch, so any old ones are dropped.
+    z->prefetch_count = 0;
+
+    if (!z->running)
     {
-        // check which is the last used bank.
-        const uint8_t old_bank = z->last_used[z->last_used_count - 1];
-        // update the next free bank slot
-        z->pool_idx[bank] = z->pool_idx[old_bank];
-        // update slot array to say that it is no longer used!
-        z->slots[old_bank] = false;
+        return;
+    }
+
+    const uint8_t guesses[ZROM_PREFETCH_COUNT] =
+    {
+        // the bank that followed this one last time
+        z->next_bank[bank] ? z->next_bank[bank] - 1 : bank,
+        // otherwise assume it's reading through banks in order
+        bank + 1 < z->header.banks ? bank + 1 : bank,
+    };
+
+    for (size_t i = 0; i < ZROM_PREFETCH_COUNT; ++i)
+    {
+        const uint8_t guess = guesses[i];
+
+        if (guess != bank && !z->slots[guess] && z->loading != guess)
+        {
+            z->prefetch[z->prefetch_count++] = guess;
+        }
+    }
 
-        ZROM_log("\t[ZROM] bank miss! old_bank: %u new_bank: %u\n", old_bank, bank);
+    if (z->prefetch_count)
+    {
+        pthread_cond_broadcast(&z->cond);
     }
-    else
+}
+
+static void* prefetch_thread(void* user)
+{
+    struct Zrom* z = (struct Zrom*)user;
+
+    ZROM_lock(z);
+
+    for (;;)
     {
-        ZROM_log("\t[ZROM] NEW Bank! bank: %u count: %u\n", bank, z->last_used_count);
+        while (!z->prefetch_count && !z->quit)
+        {
+            pthread_cond_wait(&z->cond, &z->mutex);
+        }
+
+        if (z->quit)
+        {
+            break;
+        }
+
+        const uint8_t bank = z->prefetch[0];
+        z->prefetch_count--;
+        memmove(z->prefetch, z->prefetch + 1, z->prefetch_count);
+
+        if (z->slots[bank])
+        {
+            continue;
+        }
+
+        // the core is reading from both mapped banks, so keep them
+        const int slot = claim_slot(z, bank, 2);
+
+        if (slot < 0)
+        {
+            continue;
+        }
+
+        z->loading = bank;
+        ZROM_unlock(z);
 
-        z->pool_idx[bank] = z->last_used_count;
-        z->last_used_count = MIN((size_t)z->last_used_count + 1, z->pool_count);
+        // the slot is ours until loading is cleared
+        const bool result = decompress_bank(z, bank, z->pool + (slot * ZROM_BANK_SIZE), 1);
+
+        ZROM_lock(z);
+        z->loading = -1;
+
+        if (result)
+        {
+            ZROM_log("\t[ZROM] prefetched bank: %u\n", bank);
+            z->slots[bank] = true;
+            z->prefetched[bank] = true;
+            z->last_used[z->last_used_count++] = bank;
+        }
+        else
+        {
+            z->slot_bank[slot] = -1;
+        }
+
+        pthread_cond_broadcast(&z->cond);
     }
 
-    uint8_t* next_free_bank = z->pool + (z->pool_idx[bank] * ZROM_BANK_SIZE);
+    ZROM_unlock(z);
+    return NULL;
+}
+#endif // ZROM_PREFETCH
 
-    // new bank, not compressed
-    memmove(z->last_used + 1, z->last_used, z->last_used_count);
-    z->last_used[0] = bank;
+// called with the lock held.
+static bool uncompress_bank_to_pool(struct Zrom* z, uint16_t bank, int region)
+{
+    // bank zero is always uncompressed
+    if (bank == 0)
+    {
+        z->mapped[region] = 0;
+        return true;
+    }
 
-    const struct ZromBankEntry entry = z->entries[bank];
+    --bank;
 
-    if (entry.flags & ZromEntryFlag_COMPRESSED)
+    if (bank >= z->header.banks)
     {
-        LZ4_decompress_safe((const char*)z->rom_data + entry.offset, (char*)next_free_bank, entry.size, ZROM_BANK_SIZE);
+        ZROM_log_fatal("[ZROM] bank out of range: %u\n", bank);
+        return false;
     }
-    else if (entry.flags & ZromEntryFlag_UNCOMPRESSED)
+
+#if ZROM_PREFETCH
+    // the worker has this one nearly done, so wait for it
+    while (z->loading == bank)
+    {
+        pthread_cond_wait(&z->cond, &z->mutex);
+    }
+
+    if (region == 1)
+    {
+        const uint16_t prev_bank = z->mapped[1];
+
+        // learn the switch, then guess the next one
+        if (prev_bank && prev_bank != bank + 1)
+        {
+            z->next_bank[prev_bank - 1] = bank + 1;
+            z->recent_misses = (uint8_t)((z->recent_misses << 1) | (!z->slots[bank] || z->prefetched[bank]));
+        }
+    }
+#endif
+
+    // if already uncompressed
+    if (z->slots[bank])
     {
-        memcpy((char*)next_free_bank, (const char*)z->rom_data + entry.offset, entry.size);
+        touch_bank(z, bank);
     }
     else
     {
-        ZROM_log_fatal("[ZROM] missing zrom flags...\n");
-        return false;
+        ZROM_log("\t[ZROM] NEW Bank! bank: %u count: %u\n", bank, z->last_used_count);
+
+        // the bank in this region is being replaced, so it can be evicted
+        z->mapped[region] = 0;
+        const int slot = claim_slot(z, bank, !region);
+
+        if (slot < 0)
+        {
+            ZROM_log_fatal("[ZROM] no free slot for bank: %u\n", bank);
+            return false;
+        }
+
+        if (!decompress_bank(z, bank, z->pool + (slot * ZROM_BANK_SIZE), 0))
+        {
+            z->slot_bank[slot] = -1;
+            return false;
+        }
+
+        z->slots[bank] = true;
+        touch_bank(z, bank);
     }
 
-    z->slots[bank] = true;
+    z->mapped[region] = bank + 1;
+
+#if ZROM_PREFETCH
+    if (region == 1)
+    {
+        queue_prefetch(z, bank);
+    }
+#endif
 
     return true;
 }
@@ -189,30 +730,152 @@ bool is_zrom(const uint8_t* data, size_t size)
     return header->magic == ZROM_MAGIC;
 }
 
+static void init_common(struct Zrom* z, struct GB_Core* gb)
+{
+    memset(z, 0, sizeof(struct Zrom));
+
+    z->gb = gb;
+    memset(z->slot_bank, 0xFF, sizeof(z->slot_bank));
+    memset(z->cache_mapped, 0xFF, sizeof(z->cache_mapped));
+    memset(z->cache_hint, 0xFF, sizeof(z->cache_hint));
+
+#if ZROM_PREFETCH
+    z->loading = -1;
+    pthread_mutex_init(&z->mutex, NULL);
+    pthread_cond_init(&z->cond, NULL);
+#endif
+
+    GB_set_rom_bank_callback(z->gb, on_rom_bank_callback, z);
+}
+
 bool zrom_init(struct Zrom* z, struct GB_Core* gb, uint8_t* pool, size_t size)
 {
     // size must be a multiple of ZROM_BANK_SIZE!
-    if (!size || size % ZROM_BANK_SIZE)
+    // and have room for a bank in both regions.
+    if (size < ZROM_BANK_SIZE * 2 || size % ZROM_BANK_SIZE)
     {
         return false;
     }
 
-    memset(z, 0, sizeof(struct Zrom));
+    init_common(z, gb);
 
-    z->gb = gb;
     z->pool = pool;
-    z->pool_count = size / ZROM_BANK_SIZE;
+    // there's never more banks than this, so the rest would be unused
+    z->pool_count = MIN(size / ZROM_BANK_SIZE, ZROM_MAX_BANKS);
 
-    GB_set_rom_bank_callback(z->gb, on_rom_bank_callback, z);
+    return true;
+}
+
+bool zrom_init_shared(struct Zrom* z, struct GB_Core* gb)
+{
+#if ZROM_SHARED_CACHE
+    pthread_mutex_lock(&cache.mutex);
+
+    // reserve a slot for a bank in both regions, so the cache can never
+    // be full of banks that are in use.
+    const bool has_space = cache.reserved + 2 <= cache.count;
+
+    if (has_space)
+    {
+        cache.reserved += 2;
+    }
+
+    pthread_mutex_unlock(&cache.mutex);
+
+    if (!has_space)
+    {
+        ZROM_log("[ZROM] shared cache is full, slots: %zu\n", cache.count);
+        return false;
+    }
+
+    init_common(z, gb);
+    z->shared = true;
 
     return true;
+#else
+    (void)z; (void)gb;
+    return false;
+#endif
 }
 
 void zrom_exit(struct Zrom* z)
 {
+    zrom_prefetch_stop(z);
+
+#if ZROM_SHARED_CACHE
+    if (z->shared)
+    {
+        cache_release(z, 0);
+        cache_release(z, 1);
+
+        pthread_mutex_lock(&cache.mutex);
+        cache.reserved -= 2;
+        pthread_mutex_unlock(&cache.mutex);
+    }
+#endif
+
+#ifdef HAS_ZSTD
+    ZSTD_freeDDict(z->zstd_ddict);
+    ZSTD_freeDCtx(z->zstd_dctx[0]);
+    ZSTD_freeDCtx(z->zstd_dctx[1]);
+#endif
+
+#if ZROM_PREFETCH
+    pthread_cond_destroy(&z->cond);
+    pthread_mutex_destroy(&z->mutex);
+#endif
+
     memset(z, 0, sizeof(struct Zrom));
 }
 
+// loads the dictionary (if any) of the new rom, the dctx are created on
+// the first rom with zstd banks and kept until zrom_exit().
+static bool setup_zstd(struct Zrom* z, const uint8_t* data, size_t size, const uint8_t* dict_entry)
+{
+#ifdef HAS_ZSTD
+    bool has_zstd = false;
+
+    ZSTD_freeDDict(z->zstd_ddict);
+    z->zstd_ddict = NULL;
+
+    if (z->header.flags & ZromHeaderFlag_DICT)
+    {
+        struct ZromBankEntry dict;
+        memcpy(&dict, dict_entry, sizeof(dict));
+
+        if (dict.offset > size || dict.size > size - dict.offset)
+        {
+            ZROM_log_fatal("[ZROM] invalid dict entry\n");
+            return false;
+        }
+
+        z->zstd_ddict = ZSTD_createDDict(data + dict.offset, dict.size);
+
+        if (!z->zstd_ddict)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < z->header.banks; ++i)
+    {
+        has_zstd |= (z->entries[i].flags & ZromEntryFlag_ZSTD) != 0;
+    }
+
+    for (size_t i = 0; has_zstd && i < 2; ++i)
+    {
+        if (!z->zstd_dctx[i] && !(z->zstd_dctx[i] = ZSTD_createDCtx()))
+        {
+            return false;
+        }
+    }
+#else
+    (void)z; (void)data; (void)size; (void)dict_entry;
+#endif
+
+    return true;
+}
+
 bool zrom_loadrom_compressed(struct Zrom* z, const uint8_t* data, size_t size)
 {
     if (!is_zrom(data, size))
@@ -220,12 +883,42 @@ bool zrom_loadrom_compressed(struct Zrom* z, const uint8_t* data, size_t size)
         return false;
     }
 
+    ZROM_lock(z);
+
+#if ZROM_PREFETCH
+    // the worker may still be decompressing from the old rom
+    while (z->loading >= 0)
+    {
+        pthread_cond_wait(&z->cond, &z->mutex);
+    }
+
+    z->prefetch_count = 0;
+#endif
+
+#if ZROM_SHARED_CACHE
+    if (z->shared)
+    {
+        cache_release(z, 0);
+        cache_release(z, 1);
+        z->rom_hash = hash_rom(data, size);
+        memset(z->cache_hint, 0xFF, sizeof(z->cache_hint));
+    }
+#endif
+
     z->rom_data = data;
+    z->error = false;
 
     memset(z->slots, 0, sizeof(z->slots));
     memset(z->entries, 0, sizeof(z->entries));
     memset(z->last_used, 0, sizeof(z->last_used));
     memset(z->pool_idx, 0, sizeof(z->pool_idx));
+    memset(z->slot_bank, 0xFF, sizeof(z->slot_bank));
+    memset(z->mapped, 0, sizeof(z->mapped));
+    memset(z->next_bank, 0, sizeof(z->next_bank));
+#if ZROM_PREFETCH
+    memset(z->prefetched, 0, sizeof(z->prefetched));
+    z->recent_misses = 0;
+#endif
     memset(&z->last_used_count, 0, sizeof(z->last_used_count));
 
     const uint8_t* ptr = data + ZROM_BANK_SIZE;
@@ -235,13 +928,123 @@ bool zrom_loadrom_compressed(struct Zrom* z, const uint8_t* data, size_t size)
     ZROM_log("header magic 0x%04X\n", z->header.magic);
     ZROM_log("header banks %u\n", z->header.banks);
 
-    memcpy(z->entries, ptr + sizeof(z->header), z->header.banks * sizeof(struct ZromBankEntry));
+    const size_t entries_size = z->header.banks * sizeof(struct ZromBankEntry);
+    const size_t dict_entry_size = (z->header.flags & ZromHeaderFlag_DICT) ? sizeof(struct ZromBankEntry) : 0;
+
+    if (z->header.banks > ZROM_MAX_BANKS || size < ZROM_BANK_SIZE + sizeof(z->header) + entries_size + dict_entry_size)
+    {
+        z->header.banks = 0;
+        ZROM_unlock(z);
+        return false;
+    }
+
+    memcpy(z->entries, ptr + sizeof(z->header), entries_size);
+
+    if (!setup_zstd(z, data, size, ptr + sizeof(z->header) + entries_size))
+    {
+        z->header.banks = 0;
+        ZROM_unlock(z);
+        return false;
+    }
+
+    ZROM_unlock(z);
 
     // load bank 1 immediatly
-    if (!uncompress_bank_to_pool(z, 1))
+    if (!get_bank(z, 1, 1))
+    {
+        return false;
+    }
+
+    return GB_loadrom_partial(z->gb, z->rom_data, size);
+}
+
+bool zrom_prefetch_start(struct Zrom* z)
+{
+#if ZROM_PREFETCH
+    // both mapped banks are kept, so it needs at least 1 more slot
+    if (z->running || z->shared || z->pool_count < 3)
+    {
+        return false;
+    }
+
+    z->quit = false;
+
+    if (pthread_create(&z->thread, NULL, prefetch_thread, z))
+    {
+        return false;
+    }
+
+    ZROM_lock(z);
+    z->running = true;
+    ZROM_unlock(z);
+
+    return true;
+#else
+    (void)z;
+    return false;
+#endif
+}
+
+void zrom_prefetch_stop(struct Zrom* z)
+{
+#if ZROM_PREFETCH
+    if (!z->running)
+    {
+        return;
+    }
+
+    ZROM_lock(z);
+    z->running = false;
+    z->quit = true;
+    z->prefetch_count = 0;
+    pthread_cond_broadcast(&z->cond);
+    ZROM_unlock(z);
+
+    pthread_join(z->thread, NULL);
+#else
+    (void)z;
+#endif
+}
+
+bool zrom_cache_init(uint8_t* pool, size_t size)
+{
+#if ZROM_SHARED_CACHE
+    // size must be a multiple of ZROM_BANK_SIZE!
+    if (!pool || !size || size % ZROM_BANK_SIZE)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&cache.mutex);
+
+    // a zrom is still using it
+    if (cache.reserved)
     {
+        pthread_mutex_unlock(&cache.mutex);
         return false;
     }
 
-    return GB_loadrom(z->gb, z->rom_data, size);
+    memset(cache.entries, 0, sizeof(cache.entries));
+    cache.pool = pool;
+    cache.count = MIN(size / ZROM_BANK_SIZE, ZROM_CACHE_MAX_BANKS);
+    cache.tick = 0;
+
+    pthread_mutex_unlock(&cache.mutex);
+
+    return true;
+#else
+    (void)pool; (void)size;
+    return false;
+#endif
+}
+
+void zrom_cache_exit(void)
+{
+#if ZROM_SHARED_CACHE
+    pthread_mutex_lock(&cache.mutex);
+    memset(cache.entries, 0, sizeof(cache.entries));
+    cache.pool = NULL;
+    cache.count = 0;
+    pthread_mutex_unlock(&cache.mutex);
+#endif
 }
@@ -11,6 +11,21 @@ extern "C" {
 #include <stddef.h>
 #include <gb.h>
 
+// decompress the banks the game is likely to switch to next on a
+// worker thread, see zrom_prefetch_start().
+#ifndef ZROM_PREFETCH
+    #define ZROM_PREFETCH 0
+#endif
+
+#if ZROM_PREFETCH
+    #include <pthread.h>
+#endif
+
+// process-wide bank cache that zroms can share, see zrom_init_shared().
+#ifndef ZROM_SHARED_CACHE
+    #define ZROM_SHARED_CACHE 0
+#endif
+
 
 enum ZromEntryFlag
 {
@@ -20,6 +35,22 @@ enum ZromEntryFlag
     // for those, we keep the bank uncompressed
     // which allows for memcpy speed!
     ZromEntryFlag_UNCOMPRESSED = 1 << 1,
+    // bank is compressed with zstd rather than lz4,
+    // needs zrom to be built with HAS_ZSTD.
+    ZromEntryFlag_ZSTD = 1 << 2,
+    // zstd bank compressed with the rom's dictionary,
+    // see ZromHeaderFlag_DICT.
+    ZromEntryFlag_DICT = 1 << 3,
+    // lz4 bank compressed with lz4-hc, this is only informative
+    // as it decodes the same as any other lz4 bank.
+    ZromEntryFlag_LZ4HC = 1 << 4,
+};
+
+enum ZromHeaderFlag
+{
+    // an extra entry follows the bank entries, which points to
+    // the zstd dictionary used by ZromEntryFlag_DICT banks.
+    ZromHeaderFlag_DICT = 1 << 0,
 };
 
 enum
@@ -27,13 +58,17 @@ enum
     ZROM_MAGIC = 0xFACADE,
     ZROM_MAX_BANKS = 0x100,
     ZROM_BANK_SIZE = 1024 * 16,
+    // how many banks are guessed after each switch.
+    ZROM_PREFETCH_COUNT = 2,
+    // max banks in the shared cache, the rest of the pool is unused.
+    ZROM_CACHE_MAX_BANKS = 4096,
 };
 
 struct ZromHeader
 {
     uint32_t magic;
     uint16_t banks;
-    uint16_t reserved;
+    uint16_t flags; // enum ZromHeaderFlag
 };
 
 struct ZromBankEntry
@@ -54,15 +89,69 @@ struct Zrom
     uint8_t* pool;
     size_t pool_count;
 
+    // set if a bank failed to load, ie, corrupt data. the bank reads as
+    // open bus, so the game won't run correctly after this.
+    bool error;
+
     struct ZromHeader header;
     struct ZromBankEntry entries[ZROM_MAX_BANKS];
-    
+
+    // NOTE: banks below are the index into entries, ie, rom bank - 1.
+
+    // banks in the pool, most recently used first.
     uint8_t last_used[ZROM_MAX_BANKS];
-    uint8_t last_used_count;
+    uint16_t last_used_count;
 
+    // the pool slot of each bank, only valid if slots[bank] is set.
     uint8_t pool_idx[ZROM_MAX_BANKS];
-    
+    // the bank in each pool slot, -1 if the slot is free.
+    int16_t slot_bank[ZROM_MAX_BANKS];
+
     bool slots[ZROM_MAX_BANKS];
+
+    // the rom bank mapped at 0x0000 and 0x4000, these aren't evicted
+    // as the core is reading from them.
+    uint16_t mapped[2];
+
+    // the bank that was last switched to after each bank (+1, 0 if none),
+    // this is used to guess the next switch.
+    uint8_t next_bank[ZROM_MAX_BANKS];
+
+    // zstd state, these are NULL unless built with HAS_ZSTD and the rom
+    // has zstd banks. the dctx is per thread, [1] is used by the worker.
+    void* zstd_ddict;
+    void* zstd_dctx[2];
+
+    // set by zrom_init_shared(), banks are taken from the shared cache
+    // rather than the pool above.
+    bool shared;
+    // hash of the rom, used with the bank as the cache key.
+    uint64_t rom_hash;
+    // the cache slot referenced by each region, -1 if none.
+    int16_t cache_mapped[2];
+    // the slot each bank was last found in, -1 if none. the slot may have
+    // been reused since, so its key is checked before using it.
+    int16_t cache_hint[ZROM_MAX_BANKS];
+
+#if ZROM_PREFETCH
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // banks to decompress next, newest guess first.
+    uint8_t prefetch[ZROM_PREFETCH_COUNT];
+    uint8_t prefetch_count;
+    // prefetched but not yet switched to, these are kept at the end
+    // of the lru so a wrong guess is the first to be evicted.
+    bool prefetched[ZROM_MAX_BANKS];
+    // 1 bit per recent switch, set if the bank wasn't already used in the
+    // pool. if none are set, the pool is big enough, so the worker only
+    // uses free slots rather than evicting banks that are still needed.
+    uint8_t recent_misses;
+    // bank being decompressed by the worker, -1 if none.
+    int16_t loading;
+    bool running;
+    bool quit;
+#endif
 };
 
 // this can be called before `zrom_init()`
@@ -70,10 +159,34 @@ struct Zrom
 // as is the rom itself is valid!
 GBAPI bool is_zrom(const uint8_t* data, size_t size);
 
+// the pool must have room for at least 2 banks.
 GBAPI bool zrom_init(struct Zrom* z, struct GB_Core* gb, uint8_t* pool, size_t size);
+// same as zrom_init(), but banks are shared with every other zrom using
+// the shared cache, so instances running the same rom only decompress
+// (and store) each bank once. needs zrom_cache_init() to be called first.
+// each zrom reserves 2 slots of the cache, fails if there isn't room
+// or if built without ZROM_SHARED_CACHE.
+GBAPI bool zrom_init_shared(struct Zrom* z, struct GB_Core* gb);
 GBAPI void zrom_exit(struct Zrom* z);
 GBAPI bool zrom_loadrom_compressed(struct Zrom* z, const uint8_t* data, size_t size);
 
+// starts a worker that decompresses the banks the game is likely to switch
+// to next (from the recent switches) so the switch doesn't stall.
+// needs a pool of at least 3 banks, fails if built without ZROM_PREFETCH
+// or if the zrom uses the shared cache.
+GBAPI bool zrom_prefetch_start(struct Zrom* z);
+// this is also called by zrom_exit().
+GBAPI void zrom_prefetch_stop(struct Zrom* z);
+
+// sets the pool used by the shared cache, size must be a multiple of
+// ZROM_BANK_SIZE. each running zrom keeps up to 2 banks in use, so the
+// pool needs 2 banks per zrom, the rest are evicted least recently used
+// first, across all instances.
+// fails if the cache is in use or built without ZROM_SHARED_CACHE.
+GBAPI bool zrom_cache_init(uint8_t* pool, size_t size);
+// every shared zrom must be exited before this.
+GBAPI void zrom_cache_exit(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,42 +1,339 @@
-/* cc zrom_cli.c lz4.c -Wall -O3 -std=c99 */
-// --- OR ---
-/* cc zrom_cli.c lz4.c lz4hc.c -Wall -O3 -std=c99 -DUSE_LZHC -DLZ4HC_HEAPMODE=0 */
+/* cc zrom_cli.c -I../../../core -Wall -O3 -std=c99 -pthread -llz4 */
+// --- OR, to also allow zstd banks ---
+/* cc zrom_cli.c -I../../../core -Wall -O3 -std=c99 -pthread -llz4 -DUSE_ZSTD -lzstd */
 
+// usage: zrom_cli [options] rom.gb
+//  -o path     output file (default: out.gbz)
+//  -j n        compress with n threads (default: number of cpus)
+//  -t n        decode speed / size trade-off, in bytes saved per
+//              microsecond of decode time (default: 64).
+//              0 picks the smallest codec for each bank, larger values
+//              prefer faster codecs.
+//  -c list     codecs to try, ie, "lz4,lz4hc,zstd" (default: all).
+//              banks are always stored raw if nothing beats it.
+//  -d size     zstd dictionary size, 0 to disable (default: 16384).
+
+// each bank is compressed with every codec, then the one with the lowest
+// (size + trade-off * estimated decode time) is kept.
+#define _POSIX_C_SOURCE 200809L
 
-// source code below is bad as the idea for zrom changed many times
-// and code was *thrown* in each time.
 #include "zrom.h"
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <lz4.h>
+#include <lz4hc.h>
 
-#ifdef USE_LZHC
-    #include <lz4hc.h>
+#ifdef USE_ZSTD
+    #include <zstd.h>
+    #include <zdict.h>
 #endif
 
 enum { SIXTEEN_KIB = 16384 };
 // adjust this to how much ram you have free
 enum { MAX_SPACE_LEFT = 819200 - (SIXTEEN_KIB * 3) };
-
+// the dict entry size is a uint16_t
+enum { MAX_DICT_SIZE = 0xFFFF };
+// banks are split into samples when training the dict
+enum { DICT_SAMPLE_SIZE = 1024 * 2 };
 
 typedef struct ZromHeader Header_t;
 typedef struct ZromBankEntry BankEntry_t;
 
+enum Codec
+{
+    Codec_RAW,
+    Codec_LZ4,
+    Codec_LZ4HC,
+    Codec_ZSTD,
+
+    Codec_COUNT,
+};
+
+struct CodecInfo
+{
+    const char* name;
+    uint8_t flags;
+    // rough decode speed of a single bank in MiB/s, this is only
+    // used to weigh codecs against each other.
+    unsigned speed;
+};
+
+static const struct CodecInfo CODECS[Codec_COUNT] = {
+    [Codec_RAW] = { "raw", ZromEntryFlag_UNCOMPRESSED, 10000 },
+    [Codec_LZ4] = { "lz4", ZromEntryFlag_COMPRESSED, 4000 },
+    [Codec_LZ4HC] = { "lz4hc", ZromEntryFlag_COMPRESSED | ZromEntryFlag_LZ4HC, 4000 },
+    [Codec_ZSTD] = { "zstd", ZromEntryFlag_ZSTD, 1000 },
+};
+
+struct BankResult
+{
+    uint8_t data[SIXTEEN_KIB];
+    int size;
+    uint8_t flags;
+    enum Codec codec;
+};
+
+struct Job
+{
+    const char* src;
+    struct BankResult* results;
+    int banks;
+    double trade_off;
+    bool codecs[Codec_COUNT];
+
+#ifdef USE_ZSTD
+    ZSTD_CDict* cdict;
+#endif
+
+    pthread_mutex_t mutex;
+    int next;
+};
+
+static double get_cost(enum Codec codec, int size, double trade_off)
+{
+    const double decode_us = (double)SIXTEEN_KIB / CODECS[codec].speed;
+    return size + trade_off * decode_us;
+}
+
+// returns the compressed size, or 0 if it didn't fit.
+static int compress_bank(const struct Job* job, void* ctx, enum Codec codec, const char* src, char* dst, uint8_t* flags)
+{
+    int size = 0;
+    *flags = CODECS[codec].flags;
+
+    switch (codec)
+    {
+        case Codec_RAW:
+            memcpy(dst, src, SIXTEEN_KIB);
+            size = SIXTEEN_KIB;
+            break;
+
+        case Codec_LZ4:
+            size = LZ4_compress_default(src, dst, SIXTEEN_KIB, SIXTEEN_KIB);
+            break;
+
+        case Codec_LZ4HC:
+            size = LZ4_compress_HC(src, dst, SIXTEEN_KIB, SIXTEEN_KIB, LZ4HC_CLEVEL_MAX);
+            break;
+
+        case Codec_ZSTD: {
+        #ifdef USE_ZSTD
+            size_t result = ZSTD_compressCCtx(ctx, dst, SIXTEEN_KIB, src, SIXTEEN_KIB, ZSTD_maxCLevel());
+            size = ZSTD_isError(result) ? 0 : (int)result;
+
+            // use the dict if it helps, the dict itself is only stored
+            // if at least 1 bank uses it.
+            if (job->cdict)
+            {
+                char tmp[SIXTEEN_KIB];
+                result = ZSTD_compress_usingCDict(ctx, tmp, SIXTEEN_KIB, src, SIXTEEN_KIB, job->cdict);
+
+                if (!ZSTD_isError(result) && (!size || (int)result < size))
+                {
+                    memcpy(dst, tmp, result);
+                    size = (int)result;
+                    *flags |= ZromEntryFlag_DICT;
+                }
+            }
+        #else
+            (void)job; (void)ctx;
+        #endif
+        }   break;
+
+        case Codec_COUNT:
+            break;
+    }
+
+    // compressing to exactly 16KiB is no better than raw
+    return (codec != Codec_RAW && size >= SIXTEEN_KIB) ? 0 : size;
+}
+
+static void* compress_thread(void* user)
+{
+    struct Job* job = (struct Job*)user;
+    char dst[SIXTEEN_KIB];
+    void* ctx = NULL;
+
+#ifdef USE_ZSTD
+    ctx = ZSTD_createCCtx();
+    if (!ctx)
+    {
+        return NULL;
+    }
+#endif
+
+    for (;;)
+    {
+        pthread_mutex_lock(&job->mutex);
+        const int i = job->next++;
+        pthread_mutex_unlock(&job->mutex);
+
+        if (i >= job->banks)
+        {
+            break;
+        }
+
+        const char* src = job->src + ((i + 1) * SIXTEEN_KIB);
+        struct BankResult* result = &job->results[i];
+        double best_cost = 0;
+
+        result->size = 0;
+
+        for (int codec = 0; codec < Codec_COUNT; ++codec)
+        {
+            if (!job->codecs[codec])
+            {
+                continue;
+            }
+
+            uint8_t flags = 0;
+            const int size = compress_bank(job, ctx, codec, src, dst, &flags);
+            const double cost = get_cost(codec, size, job->trade_off);
+
+            if (size > 0 && (!result->size || cost < best_cost))
+            {
+                memcpy(result->data, dst, size);
+                result->size = size;
+                result->flags = flags;
+                result->codec = codec;
+                best_cost = cost;
+            }
+        }
+    }
+
+#ifdef USE_ZSTD
+    ZSTD_freeCCtx(ctx);
+#endif
+
+    return NULL;
+}
+
+#ifdef USE_ZSTD
+// returns the dict size, or 0 if training failed.
+static size_t train_dict(const char* src, int banks, void* dict, size_t dict_size)
+{
+    const unsigned samples = banks * (SIXTEEN_KIB / DICT_SAMPLE_SIZE);
+    size_t* sample_sizes = (size_t*)malloc(sizeof(size_t) * samples);
+
+    for (unsigned i = 0; i < samples; ++i)
+    {
+        sample_sizes[i] = DICT_SAMPLE_SIZE;
+    }
+
+    const size_t result = ZDICT_trainFromBuffer(dict, dict_size, src + SIXTEEN_KIB, sample_sizes, samples);
+    free(sample_sizes);
+
+    if (ZDICT_isError(result))
+    {
+        printf("failed to train dict: %s\n", ZDICT_getErrorName(result));
+        return 0;
+    }
+
+    return result;
+}
+#endif
+
+static bool parse_codecs(const char* list, bool* codecs)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", list);
+
+    memset(codecs, 0, sizeof(bool) * Codec_COUNT);
+    codecs[Codec_RAW] = true;
+
+    for (char* name = strtok(buf, ","); name; name = strtok(NULL, ","))
+    {
+        int codec = 0;
+
+        while (codec < Codec_COUNT && strcmp(name, CODECS[codec].name))
+        {
+            codec++;
+        }
+
+        if (codec == Codec_COUNT)
+        {
+            printf("unknown codec: %s\n", name);
+            return false;
+        }
+
+    #ifndef USE_ZSTD
+        if (codec == Codec_ZSTD)
+        {
+            printf("built without zstd, rebuild with -DUSE_ZSTD\n");
+            return false;
+        }
+    #endif
+
+        codecs[codec] = true;
+    }
+
+    return true;
+}
 
 int main(int argc, char** argv)
 {
-    if (argc < 2)
+    const char* out_path = "out.gbz";
+    const char* codec_list = "lz4,lz4hc,zstd";
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    double trade_off = 64;
+    long dict_size = SIXTEEN_KIB;
+    int opt;
+
+#ifndef USE_ZSTD
+    codec_list = "lz4,lz4hc";
+#endif
+
+    while ((opt = getopt(argc, argv, "o:j:t:c:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o': out_path = optarg; break;
+            case 'j': threads = atol(optarg); break;
+            case 't': trade_off = atof(optarg); break;
+            case 'c': codec_list = optarg; break;
+            case 'd': dict_size = atol(optarg); break;
+            default: exit(-1);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        printf("usage: %s [-o out.gbz] [-j threads] [-t trade-off] [-c lz4,lz4hc,zstd] [-d dict_size] rom.gb\n", argv[0]);
+        exit(-1);
+    }
+
+    const char* rom_path = argv[optind];
+
+    struct Job job = {
+        .trade_off = trade_off < 0 ? 0 : trade_off,
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+    };
+
+    if (!parse_codecs(codec_list, job.codecs))
     {
         exit(-1);
     }
 
-    static char dst[SIXTEEN_KIB];
+    if (threads < 1)
+    {
+        threads = 1;
+    }
 
-    FILE* f = fopen(argv[1], "rb");
-    assert(f);
+    if (dict_size < 0 || dict_size > MAX_DICT_SIZE)
+    {
+        dict_size = MAX_DICT_SIZE;
+    }
+
+    FILE* f = fopen(rom_path, "rb");
+    if (!f)
+    {
+        printf("failed to open: %s\n", rom_path);
+        exit(-1);
+    }
 
     fseek(f, 0, SEEK_END);
     const int size = ftell(f);
@@ -44,12 +341,22 @@ int main(int argc, char** argv)
 
     char* src = (char*)malloc(size);
 
-    fread(src, size, 1, f);
+    if (!src || fread(src, size, 1, f) != 1)
+    {
+        printf("failed to read: %s\n", rom_path);
+        exit(-1);
+    }
+
     fclose(f);
     f = NULL;
 
     const int banks = (size / SIXTEEN_KIB) - 1;
-    assert(banks >= 1);
+
+    if (banks < 1)
+    {
+        printf("rom is too small!\n");
+        exit(-1);
+    }
 
     // will never happen, max size is 4MiB which is the largest rom
     if (banks >= 0x100)
@@ -58,65 +365,151 @@ int main(int argc, char** argv)
         exit(-1);
     }
 
+    job.src = src;
+    job.banks = banks;
+    job.results = (struct BankResult*)malloc(sizeof(struct BankResult) * banks);
+
+    void* dict = NULL;
+    size_t dict_len = 0;
+
+#ifdef USE_ZSTD
+    if (job.codecs[Codec_ZSTD] && dict_size)
+    {
+        dict = malloc(dict_size);
+        dict_len = train_dict(src, banks, dict, dict_size);
+
+        if (dict_len)
+        {
+            job.cdict = ZSTD_createCDict(dict, dict_len, ZSTD_maxCLevel());
+        }
+    }
+#endif
+
+    pthread_t* thread_ids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    long started = 0;
+
+    for (; started < threads && started < banks; ++started)
+    {
+        if (pthread_create(&thread_ids[started], NULL, compress_thread, &job))
+        {
+            break;
+        }
+    }
+
+    // if no threads could be created, do it all here instead
+    if (!started)
+    {
+        compress_thread(&job);
+    }
+
+    for (long i = 0; i < started; ++i)
+    {
+        pthread_join(thread_ids[i], NULL);
+    }
+
+    free(thread_ids);
+
+    int codec_count[Codec_COUNT] = {0};
+    bool uses_dict = false;
+
+    for (int i = 0; i < banks; ++i)
+    {
+        if (!job.results[i].size)
+        {
+            printf("failed to compress bank: %d\n", i + 1);
+            exit(-1);
+        }
+
+        codec_count[job.results[i].codec]++;
+        uses_dict |= (job.results[i].flags & ZromEntryFlag_DICT) != 0;
+    }
+
+    if (!uses_dict)
+    {
+        dict_len = 0;
+    }
+
     const Header_t header = {
         .magic = ZROM_MAGIC,
         .banks = banks,
-        .reserved = 0
+        .flags = uses_dict ? ZromHeaderFlag_DICT : 0,
     };
 
-    BankEntry_t* entries = (BankEntry_t*)malloc(sizeof(BankEntry_t) * banks);
+    const int entries_size = sizeof(BankEntry_t) * (banks + uses_dict);
+    BankEntry_t* entries = (BankEntry_t*)calloc(banks + 1, sizeof(BankEntry_t));
 
-    f = fopen("out.gbz", "wb");
-    assert(f);
+    int offset = SIXTEEN_KIB + sizeof(Header_t) + entries_size;
 
-    fwrite(src, SIXTEEN_KIB, 1, f);
-    fwrite(&header, sizeof(Header_t), 1, f);
-    fwrite(entries, sizeof(BankEntry_t) * banks, 1, f);
+    // the dict entry goes after the bank entries, followed by the dict
+    if (uses_dict)
+    {
+        entries[banks].offset = (uint32_t)offset;
+        entries[banks].size = (uint16_t)dict_len;
+        offset += dict_len;
+    }
 
-    int offset = sizeof(Header_t) + (sizeof(BankEntry_t) * banks) + SIXTEEN_KIB;
-    int total_lz4_size = 0;
+    int total_comp_size = dict_len;
 
     for (int i = 0; i < banks; ++i)
     {
-        int comp_size = 0;
-
-        #ifdef USE_LZHC
-            comp_size = LZ4_compress_HC(src + ((i + 1) * SIXTEEN_KIB), dst, SIXTEEN_KIB, SIXTEEN_KIB, LZ4HC_CLEVEL_MAX);
-        #else
-            comp_size = LZ4_compress_default(src + ((i + 1) * SIXTEEN_KIB), dst, SIXTEEN_KIB, SIXTEEN_KIB);
-        #endif
+        entries[i].size = (uint16_t)job.results[i].size;
+        entries[i].offset = (uint32_t)offset;
+        entries[i].flags = job.results[i].flags;
+        printf("\tBank %03d: %-5s size: %u offset: %u\n", i + 1, CODECS[job.results[i].codec].name, entries[i].size, entries[i].offset);
 
-        // failed to compress, store it raw
-        if (comp_size <= 0)
-        {
-            comp_size = SIXTEEN_KIB;
-            entries[i].flags = ZromEntryFlag_UNCOMPRESSED;
-            memcpy(dst, src + ((i + 1) * SIXTEEN_KIB), SIXTEEN_KIB);
-        }
-        else
-        {
-            entries[i].flags = ZromEntryFlag_COMPRESSED;
-        }
+        offset += job.results[i].size;
+        total_comp_size += job.results[i].size;
+    }
 
-        fwrite(dst, comp_size, 1, f);
+    f = fopen(out_path, "wb");
+    if (!f)
+    {
+        printf("failed to open: %s\n", out_path);
+        exit(-1);
+    }
 
-        entries[i].size = (uint32_t)comp_size;
-        entries[i].offset = (uint32_t)offset;
-        printf("\tBank %03d: size: %u offset: %u\n", i + 1, entries[i].size, entries[i].offset);
+    fwrite(src, SIXTEEN_KIB, 1, f);
+    fwrite(&header, sizeof(Header_t), 1, f);
+    fwrite(entries, entries_size, 1, f);
 
-        offset += comp_size;
-        total_lz4_size += comp_size;
+#ifdef USE_ZSTD
+    if (uses_dict)
+    {
+        fwrite(dict, dict_len, 1, f);
     }
+#endif
 
-    fseek(f, SIXTEEN_KIB + sizeof(Header_t), SEEK_SET);
-    fwrite(entries, (sizeof(BankEntry_t) * banks), 1, f);
+    for (int i = 0; i < banks; ++i)
+    {
+        fwrite(job.results[i].data, job.results[i].size, 1, f);
+    }
 
     fclose(f);
+
+#ifdef USE_ZSTD
+    ZSTD_freeCDict(job.cdict);
+#endif
+    free(dict);
     free(entries);
+    free(job.results);
     free(src);
 
-    printf("%s\tsize: %d\tbanks: %d\n\n", argv[1], size, banks);
-    printf("lz4_size: %d\tdiff: %d\tleft: %d\t%s\n", total_lz4_size, total_lz4_size - size, MAX_SPACE_LEFT - total_lz4_size, total_lz4_size > MAX_SPACE_LEFT ? "NO-FIT" : "FITS");
+    printf("%s\tsize: %d\tbanks: %d\tthreads: %ld\n\n", rom_path, size, banks, threads);
+
+    for (int codec = 0; codec < Codec_COUNT; ++codec)
+    {
+        if (codec_count[codec])
+        {
+            printf("%s: %d banks\n", CODECS[codec].name, codec_count[codec]);
+        }
+    }
+
+    if (uses_dict)
+    {
+        printf("dict: %zu bytes\n", dict_len);
+    }
+
+    printf("comp_size: %d\tdiff: %d\tleft: %d\t%s\n", total_comp_size, total_comp_size - size, MAX_SPACE_LEFT - total_comp_size, total_comp_size > MAX_SPACE_LEFT ? "NO-FIT" : "FITS");
 
     return 0;
 }
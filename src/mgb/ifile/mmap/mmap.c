@@ -0,0 +1,265 @@
+#include "mmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(EMSCRIPTEN) && !defined(__vita__)
+    #define HAS_MMAP 1
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+
+#ifdef HAS_MMAP
+
+typedef struct
+{
+    uint8_t* data;
+    size_t offset;
+    size_t size;
+    bool writable;
+} ctx_t;
+
+#define PRIVATE_TO_CTX ctx_t* ctx = (ctx_t*)_private
+
+
+static void internal_close(void* _private)
+{
+    PRIVATE_TO_CTX;
+
+    if (ctx->data)
+    {
+        munmap(ctx->data, ctx->size);
+        ctx->data = NULL;
+    }
+
+    free(ctx);
+}
+
+static bool internal_read(void* _private, void* data, size_t len)
+{
+    PRIVATE_TO_CTX;
+
+    if (ctx->offset + len > ctx->size)
+    {
+        return false;
+    }
+
+    memcpy(data, ctx->data + ctx->offset, len);
+
+    ctx->offset += len;
+
+    return true;
+}
+
+static bool internal_write(void* _private, const void* data, size_t len)
+{
+    PRIVATE_TO_CTX;
+
+    if (!ctx->writable || ctx->offset + len > ctx->size)
+    {
+        return false;
+    }
+
+    memcpy(ctx->data + ctx->offset, data, len);
+
+    ctx->offset += len;
+
+    return true;
+}
+
+static bool internal_seek(void* _private, long offset, int whence)
+{
+    PRIVATE_TO_CTX;
+
+    switch (whence)
+    {
+        case 0:
+            ctx->offset = offset;
+            return true;
+
+        case 1:
+            ctx->offset += offset;
+            return true;
+
+        case 2:
+            ctx->offset = ctx->size + offset;
+            return true;
+    }
+
+    return false;
+}
+
+static size_t internal_tell(void* _private)
+{
+    PRIVATE_TO_CTX;
+
+    return ctx->offset;
+}
+
+static size_t internal_size(void* _private)
+{
+    PRIVATE_TO_CTX;
+
+    return ctx->size;
+}
+
+static IFile_t* internal_open(int fd, size_t size, bool writable)
+{
+    void* data = MAP_FAILED;
+
+    if (size)
+    {
+        // read-only + private means every process mapping the same file
+        // shares the pages in the page cache.
+        const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        const int share = writable ? MAP_SHARED : MAP_PRIVATE;
+        data = mmap(NULL, size, prot, share, fd, 0);
+    }
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    IFile_t* ifile = malloc(sizeof(IFile_t));
+    ctx_t* ctx = malloc(sizeof(ctx_t));
+
+    if (!ifile || !ctx)
+    {
+        munmap(data, size);
+        free(ifile);
+        free(ctx);
+        return NULL;
+    }
+
+    const ctx_t _ctx =
+    {
+        .data = (uint8_t*)data,
+        .offset = 0,
+        .size = size,
+        .writable = writable,
+    };
+
+    *ctx = _ctx;
+
+    const IFile_t _ifile =
+    {
+        ._private = ctx,
+        .close  = internal_close,
+        .read   = internal_read,
+        .write  = internal_write,
+        .seek   = internal_seek,
+        .tell   = internal_tell,
+        .size   = internal_size,
+    };
+
+    *ifile = _ifile;
+
+    return ifile;
+}
+
+// returns 0 if not a regular file, as it can't be mapped
+static size_t get_file_size(int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        return (size_t)st.st_size;
+    }
+
+    return 0;
+}
+
+IFile_t* immap_open(const char* file, enum IFileMode mode, int flags)
+{
+    (void)flags;
+
+    if (mode != IFileMode_READ)
+    {
+        return NULL;
+    }
+
+    const int fd = open(file, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    return internal_open(fd, get_file_size(fd), false);
+}
+
+IFile_t* immap_open_shared(const char* file, size_t size)
+{
+    const int fd = open(file, O_RDWR | O_CREAT, 0644);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    const size_t file_size = get_file_size(fd);
+
+    // grow the file, bigger files are mapped whole
+    if (file_size < size && ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    return internal_open(fd, file_size < size ? size : file_size, true);
+}
+
+void* immap_get_data(IFile_t* ifile)
+{
+    const ctx_t* ctx = (const ctx_t*)ifile->_private;
+
+    return ctx->data;
+}
+
+bool immap_sync(IFile_t* ifile, bool wait)
+{
+    const ctx_t* ctx = (const ctx_t*)ifile->_private;
+
+    if (!ctx->writable)
+    {
+        return true;
+    }
+
+    return 0 == msync(ctx->data, ctx->size, wait ? MS_SYNC : MS_ASYNC);
+}
+
+#else
+
+IFile_t* immap_open(const char* file, enum IFileMode mode, int flags)
+{
+    (void)file; (void)mode; (void)flags;
+    return NULL;
+}
+
+IFile_t* immap_open_shared(const char* file, size_t size)
+{
+    (void)file; (void)size;
+    return NULL;
+}
+
+void* immap_get_data(IFile_t* ifile)
+{
+    (void)ifile;
+    return NULL;
+}
+
+bool immap_sync(IFile_t* ifile, bool wait)
+{
+    (void)ifile; (void)wait;
+    return false;
+}
+
+#endif // HAS_MMAP
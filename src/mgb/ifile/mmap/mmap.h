@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../ifile.h"
+
+
+// maps the whole file read-only, reads are memcpy from the mapping.
+// returns NULL if mmap isn't supported on this platform or the file
+// can't be mapped (ie, empty), so the caller should fall back to cfile.
+IFile_t* immap_open(const char* file, enum IFileMode mode, int flags);
+
+// maps the file read / write and shared, so writes to the mapping go
+// to the file. the file is created, or grown to [size] if smaller.
+IFile_t* immap_open_shared(const char* file, size_t size);
+
+// returns the start of the mapping, valid until the ifile is closed.
+// this can be handed to GB_loadrom() to avoid copying the rom.
+// only writable if opened with immap_open_shared().
+// only call these on an ifile returned from immap_open*()!
+void* immap_get_data(IFile_t* ifile);
+// flushes writes to the file, if [wait] is false, this only
+// schedules the writeback.
+bool immap_sync(IFile_t* ifile, bool wait);
+
+#ifdef __cplusplus
+}
+#endif
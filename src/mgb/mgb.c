@@ -6,8 +6,11 @@
 #include "ifile/cfile/cfile.h"
 #include "ifile/gzip/gzip.h"
 #include "ifile/mem/mem.h"
+#include "ifile/mmap/mmap.h"
+#include "compressors.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <gb.h>
 #include <assert.h>
@@ -73,18 +76,31 @@ struct mgb
     char rom_path[0x304];
     uint8_t rom_data[GB_ROM_SIZE_MAX];
     size_t rom_size;
+    // if set, the rom is read directly from this mapping rather
+    // than being copied to rom_data, kept open whilst loaded.
+    IFile_t* rom_mmap;
     bool has_rom;
 
     uint8_t sram_data[GB_SAVE_SIZE_MAX];
     size_t sram_size;
     bool has_sram;
+    // if set, the sram is the save file mapped into memory rather
+    // than sram_data, see mgb_set_save_mmap().
+    IFile_t* sram_mmap;
+    struct SafeString sram_mmap_path;
+    bool use_sram_mmap;
 
     bool rom_loaded;
+
+    // used for rewind and save states
+    enum CompressorType compressor;
 };
 
 
 static void free_game(void);
 static void loadsave(void);
+static bool loadsave_mmap(const char* path);
+static void close_save_mmap(void);
 static bool loadrom(const struct LoadRomConfig* config);
 
 // globals
@@ -96,6 +112,13 @@ static void free_game(void)
     mgb_save_save_file(NULL);
     // mgb_save_state_file(NULL);
     mgb.rom_loaded = false;
+    close_save_mmap();
+
+    if (mgb.rom_mmap)
+    {
+        ifile_close(mgb.rom_mmap);
+        mgb.rom_mmap = NULL;
+    }
 }
 
 static void loadsave(void)
@@ -104,6 +127,12 @@ static void loadsave(void)
     {
         const struct SafeString ss = util_create_save_path(mgb.save_folder, mgb.rom_path);
 
+        // the core then reads / writes the file directly
+        if (ss_valid(&ss) && mgb.use_sram_mmap && loadsave_mmap(ss.str))
+        {
+            return;
+        }
+
         if (ss_valid(&ss))
         {
             IFile_t* file = icfile_open(ss.str, IFileMode_READ, 0);
@@ -136,11 +165,15 @@ static void loadsave(void)
 
     // we always set sram!
     GB_set_sram(mgb.gb, mgb.sram_data, sizeof(mgb.sram_data));
+    // it matches what's on disk
+    GB_clear_sram_dirty(mgb.gb);
 }
 
 static bool loadrom(const struct LoadRomConfig* config)
 {
     IFile_t* romloader = NULL;
+    const uint8_t* rom_data = mgb.rom_data;
+    bool mapped = false;
 
     if (mgb_has_rom())
     {
@@ -150,7 +183,13 @@ static bool loadrom(const struct LoadRomConfig* config)
     switch (config->type)
     {
         case LoadRomType_FILE:
-            romloader = romloader_open(config->path);
+            // try mapping first, then fallback to reading it in
+            romloader = romloader_open_mmap(config->path);
+            mapped = romloader != NULL;
+            if (!mapped)
+            {
+                romloader = romloader_open(config->path);
+            }
             break;
 
         case LoadRomType_MEM:
@@ -175,7 +214,11 @@ static bool loadrom(const struct LoadRomConfig* config)
         goto fail;
     }
 
-    if (!ifile_read(romloader, mgb.rom_data, mgb.rom_size))
+    if (mapped)
+    {
+        rom_data = immap_get_data(romloader);
+    }
+    else if (!ifile_read(romloader, mgb.rom_data, mgb.rom_size))
     {
         mgb_log_err("[MGB] fail to read size: %zu\n", mgb.rom_size);
         goto fail;
@@ -184,14 +227,21 @@ static bool loadrom(const struct LoadRomConfig* config)
     // todo: move this somewhere more tidy
     GB_set_sram(mgb.gb, mgb.sram_data, sizeof(mgb.sram_data));
 
-    if (!GB_loadrom(mgb.gb, mgb.rom_data, mgb.rom_size))
+    if (!GB_loadrom(mgb.gb, rom_data, mgb.rom_size))
     {
         mgb_log_err("[MGB] fail to gb load rom\n");
         goto fail;
     }
 
-    // free everything
-    ifile_close(romloader);
+    // the core reads from the mapping, so keep it open until unloaded
+    if (mapped)
+    {
+        mgb.rom_mmap = romloader;
+    }
+    else
+    {
+        ifile_close(romloader);
+    }
     romloader = NULL;
 
     // save the path
@@ -334,6 +384,27 @@ bool mgb_save_save_file(const char* path)
         return false;
     }
 
+    // the save is the mapped file, so only needs flushing
+    if (mgb.sram_mmap && (!path || !strcmp(path, mgb.sram_mmap_path.str)))
+    {
+        if (immap_sync(mgb.sram_mmap, true))
+        {
+            mgb_log("[MGB] synced save: %s\n", mgb.sram_mmap_path.str);
+            if (mgb.on_file_cb)
+            {
+                mgb.on_file_cb(mgb.sram_mmap_path.str, CallbackType_SAVE_SAVE, true);
+            }
+            return true;
+        }
+
+        mgb_log_err("[MGB] failed to sync save: %s\n", mgb.sram_mmap_path.str);
+        if (mgb.on_file_cb)
+        {
+            mgb.on_file_cb(mgb.sram_mmap_path.str, CallbackType_SAVE_SAVE, false);
+        }
+        return false;
+    }
+
     if (GB_has_save(mgb.gb))
     {
         struct SafeString ss = {0};
@@ -354,7 +425,8 @@ bool mgb_save_save_file(const char* path)
             if (file)
             {
                 const size_t save_size = GB_calculate_savedata_size(mgb.gb);
-                const bool result = ifile_write(file, mgb.sram_data, save_size);
+                const uint8_t* sram = mgb.sram_mmap ? immap_get_data(mgb.sram_mmap) : mgb.sram_data;
+                const bool result = ifile_write(file, sram, save_size);
                 ifile_close(file);
 
                 if (result)
@@ -394,6 +466,248 @@ bool mgb_save_save_file(const char* path)
     return true;
 }
 
+#ifdef HAS_SDL2
+// msync can block for a while (ie, network drives), so it's done here.
+static struct
+{
+    SDL_Thread* thread;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    bool pending;
+    bool quit;
+} save_sync = {0};
+
+static int save_sync_thread(void* user)
+{
+    (void)user;
+
+    SDL_LockMutex(save_sync.mutex);
+
+    for (;;)
+    {
+        while (!save_sync.pending && !save_sync.quit)
+        {
+            SDL_CondWait(save_sync.cond, save_sync.mutex);
+        }
+
+        if (save_sync.quit)
+        {
+            break;
+        }
+
+        save_sync.pending = false;
+        SDL_UnlockMutex(save_sync.mutex);
+
+        // the mapping is only closed after this thread has exited
+        if (!immap_sync(mgb.sram_mmap, true))
+        {
+            mgb_log_err("[MGB] failed to sync save: %s\n", mgb.sram_mmap_path.str);
+        }
+
+        SDL_LockMutex(save_sync.mutex);
+    }
+
+    SDL_UnlockMutex(save_sync.mutex);
+    return 0;
+}
+
+static void save_sync_close(void)
+{
+    if (save_sync.thread)
+    {
+        SDL_LockMutex(save_sync.mutex);
+        save_sync.quit = true;
+        SDL_CondBroadcast(save_sync.cond);
+        SDL_UnlockMutex(save_sync.mutex);
+        SDL_WaitThread(save_sync.thread, NULL);
+    }
+
+    if (save_sync.cond) { SDL_DestroyCond(save_sync.cond); }
+    if (save_sync.mutex) { SDL_DestroyMutex(save_sync.mutex); }
+
+    memset(&save_sync, 0, sizeof(save_sync));
+}
+
+static void save_sync_init(void)
+{
+    save_sync_close();
+
+    save_sync.mutex = SDL_CreateMutex();
+    save_sync.cond = SDL_CreateCond();
+
+    if (save_sync.mutex && save_sync.cond)
+    {
+        save_sync.thread = SDL_CreateThread(save_sync_thread, "save_sync", NULL);
+    }
+
+    // not fatal, syncs are then scheduled from the calling thread
+    if (!save_sync.thread)
+    {
+        mgb_log_err("[MGB] failed to create save sync thread: %s\n", SDL_GetError());
+        save_sync_close();
+    }
+}
+#endif // HAS_SDL2
+
+static bool loadsave_mmap(const char* path)
+{
+    const size_t save_size = GB_calculate_savedata_size(mgb.gb);
+    IFile_t* file = immap_open_shared(path, save_size);
+
+    if (!file)
+    {
+        mgb_log_err("[MGB] failed to map save: %s, falling back to reading it\n", path);
+        return false;
+    }
+
+    mgb.sram_mmap = file;
+    strncpy(mgb.sram_mmap_path.str, path, sizeof(mgb.sram_mmap_path.str) - 1);
+
+    // the file may be bigger, ie, a vba save with rtc at the end
+    GB_set_sram(mgb.gb, immap_get_data(file), ifile_size(file));
+    GB_clear_sram_dirty(mgb.gb);
+
+#ifdef HAS_SDL2
+    save_sync_init();
+#endif
+
+    mgb_log("[MGB] mapped save: %s\n", path);
+    return true;
+}
+
+static void close_save_mmap(void)
+{
+    if (!mgb.sram_mmap)
+    {
+        return;
+    }
+
+#ifdef HAS_SDL2
+    save_sync_close();
+#endif
+
+    ifile_close(mgb.sram_mmap);
+    mgb.sram_mmap = NULL;
+    memset(&mgb.sram_mmap_path, 0, sizeof(mgb.sram_mmap_path));
+
+    // don't leave the core pointing at the unmapped file
+    GB_set_sram(mgb.gb, mgb.sram_data, sizeof(mgb.sram_data));
+}
+
+void mgb_set_save_mmap(bool enable)
+{
+    mgb.use_sram_mmap = enable;
+}
+
+bool mgb_sync_save(void)
+{
+    if (!mgb_has_rom() || !GB_is_sram_dirty(mgb.gb))
+    {
+        return false;
+    }
+
+    GB_clear_sram_dirty(mgb.gb);
+
+    if (!mgb.sram_mmap)
+    {
+        return mgb_save_save_file(NULL);
+    }
+
+#ifdef HAS_SDL2
+    if (save_sync.thread)
+    {
+        SDL_LockMutex(save_sync.mutex);
+        save_sync.pending = true;
+        SDL_CondSignal(save_sync.cond);
+        SDL_UnlockMutex(save_sync.mutex);
+        return true;
+    }
+#endif
+
+    return immap_sync(mgb.sram_mmap, false);
+}
+
+// state files compressed with anything other than zlib start with this,
+// followed by the compressed GB_State.
+struct StateFileHeader
+{
+    uint32_t magic;
+    uint32_t compressor; // enum CompressorType
+    uint32_t size;
+    uint32_t compressed_size;
+};
+
+enum { STATE_FILE_MAGIC = 0x5354474D }; // "MGTS"
+
+static bool write_compressed_state(IFile_t* file)
+{
+    const compressor_func_t compressor = compressor_get(mgb.compressor);
+    const size_t bound = compressor_get_size(mgb.compressor)(sizeof(mgb.state));
+    uint8_t* data = malloc(bound);
+    bool result = false;
+
+    if (data)
+    {
+        const size_t compressed_size = compressor(data, bound, &mgb.state, sizeof(mgb.state), CompressMode_DEFLATE);
+
+        if (compressed_size != (size_t)-1)
+        {
+            const struct StateFileHeader header =
+            {
+                .magic = STATE_FILE_MAGIC,
+                .compressor = mgb.compressor,
+                .size = sizeof(mgb.state),
+                .compressed_size = (uint32_t)compressed_size,
+            };
+
+            result = ifile_write(file, &header, sizeof(header)) && ifile_write(file, data, compressed_size);
+        }
+
+        free(data);
+    }
+
+    return result;
+}
+
+// returns false if this isn't a compressed state, or it fails to load.
+static bool read_compressed_state(IFile_t* file)
+{
+    struct StateFileHeader header;
+    bool result = false;
+
+    if (ifile_size(file) < sizeof(header) || !ifile_read(file, &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    if (header.magic != STATE_FILE_MAGIC || header.size != sizeof(mgb.state) || header.compressed_size > ifile_size(file) - sizeof(header))
+    {
+        return false;
+    }
+
+    const compressor_func_t compressor = compressor_get((enum CompressorType)header.compressor);
+
+    if (!compressor)
+    {
+        mgb_log_err("[MGB] state uses %s which isn't available\n", compressor_get_name((enum CompressorType)header.compressor));
+        return false;
+    }
+
+    uint8_t* data = malloc(header.compressed_size);
+
+    if (data)
+    {
+        if (ifile_read(file, data, header.compressed_size))
+        {
+            result = compressor(&mgb.state, sizeof(mgb.state), data, header.compressed_size, CompressMode_INFLATE) == sizeof(mgb.state);
+        }
+
+        free(data);
+    }
+
+    return result;
+}
+
 bool mgb_save_state_file(const char* path)
 {
     IFile_t* file = NULL;
@@ -413,7 +727,16 @@ bool mgb_save_state_file(const char* path)
         goto fail;
     }
 
-    file = igzip_open(ss.str, IFileMode_WRITE, 0);
+    // zlib states are gzip files, the others have their own header.
+    if (mgb.compressor == CompressorType_ZLIB)
+    {
+        file = igzip_open(ss.str, IFileMode_WRITE, 0);
+    }
+    else
+    {
+        file = icfile_open(ss.str, IFileMode_WRITE, 0);
+    }
+
     if (!file)
     {
         mgb_log_err("[MGB] failed to open\n");
@@ -426,7 +749,15 @@ bool mgb_save_state_file(const char* path)
         goto fail;
     }
 
-    if (!ifile_write(file, &mgb.state, sizeof(mgb.state)))
+    if (mgb.compressor == CompressorType_ZLIB)
+    {
+        if (!ifile_write(file, &mgb.state, sizeof(mgb.state)))
+        {
+            mgb_log_err("[MGB] failed to write\n");
+            goto fail;
+        }
+    }
+    else if (!write_compressed_state(file))
     {
         mgb_log_err("[MGB] failed to write\n");
         goto fail;
@@ -479,18 +810,28 @@ bool mgb_load_state_file(const char* path)
 
     mgb_log("[MGB] trying to load state from: %s\n", ss.str);
 
-    file = igzip_open(ss.str, IFileMode_READ, 0);
-    if (!file)
+    // try the zstd / lz4 format first, otherwise it's a gzip file.
+    file = icfile_open(ss.str, IFileMode_READ, 0);
+    if (!file || !read_compressed_state(file))
     {
-        mgb_log_err("[MGB] failed to open file: %s\n", ss.str);
-        goto fail;
-    }
+        if (file)
+        {
+            ifile_close(file);
+        }
 
-    // todo: error check this
-    if (!ifile_read(file, &mgb.state, sizeof(mgb.state)))
-    {
-        mgb_log_err("[MGB] failed to read file: %s\n", ss.str);
-        goto fail;
+        file = igzip_open(ss.str, IFileMode_READ, 0);
+        if (!file)
+        {
+            mgb_log_err("[MGB] failed to open file: %s\n", ss.str);
+            goto fail;
+        }
+
+        // todo: error check this
+        if (!ifile_read(file, &mgb.state, sizeof(mgb.state)))
+        {
+            mgb_log_err("[MGB] failed to read file: %s\n", ss.str);
+            goto fail;
+        }
     }
 
     if (!GB_loadstate(mgb.gb, &mgb.state))
@@ -606,29 +947,276 @@ void mgb_set_on_file_callback(void (*cb)(const char*, enum CallbackType, bool))
     mgb.on_file_cb = cb;
 }
 
+bool mgb_set_compressor(enum CompressorType type)
+{
+    if (!compressor_is_available(type))
+    {
+        mgb_log_err("[MGB] %s compression is not available\n", compressor_get_name(type));
+        return false;
+    }
+
+    mgb.compressor = type;
+    return true;
+}
+
+enum CompressorType mgb_get_compressor(void)
+{
+    return mgb.compressor;
+}
+
 #include "rewind.h"
-#include "compressors.h"
 
 static struct RewindState rewind_state = {0};
 static struct Rewind rewinder = {0};
 
+#ifdef HAS_SDL2
+// when async, the emu thread only copies the frame into a slot, the
+// worker then does the xor / compression via rewind_push().
+// the slots are the newest frames, so a pop takes from here first.
+enum { REWIND_ASYNC_SLOTS = 4 };
+
+static struct
+{
+    struct RewindState slots[REWIND_ASYNC_SLOTS];
+    SDL_Thread* thread;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    unsigned head; // next slot to write
+    unsigned count; // slots waiting to be pushed
+    bool busy; // worker is pushing the oldest slot
+    bool quit;
+} rewind_async = {0};
+
+static int rewind_async_thread(void* user)
+{
+    (void)user;
+
+    SDL_LockMutex(rewind_async.mutex);
+
+    for (;;)
+    {
+        while (!rewind_async.count && !rewind_async.quit)
+        {
+            SDL_CondWait(rewind_async.cond, rewind_async.mutex);
+        }
+
+        if (rewind_async.quit)
+        {
+            break;
+        }
+
+        const unsigned tail = (rewind_async.head + REWIND_ASYNC_SLOTS - rewind_async.count) % REWIND_ASYNC_SLOTS;
+        rewind_async.busy = true;
+        SDL_UnlockMutex(rewind_async.mutex);
+
+        // the slot and rewinder are only touched by this thread whilst busy
+        rewind_push(&rewinder, (const uint8_t*)&rewind_async.slots[tail], sizeof(rewind_async.slots[tail]));
+
+        SDL_LockMutex(rewind_async.mutex);
+        rewind_async.count--;
+        rewind_async.busy = false;
+        SDL_CondBroadcast(rewind_async.cond);
+    }
+
+    SDL_UnlockMutex(rewind_async.mutex);
+    return 0;
+}
+
+static void rewind_async_close(void)
+{
+    if (rewind_async.thread)
+    {
+        SDL_LockMutex(rewind_async.mutex);
+        rewind_async.quit = true;
+        SDL_CondBroadcast(rewind_async.cond);
+        SDL_UnlockMutex(rewind_async.mutex);
+        SDL_WaitThread(rewind_async.thread, NULL);
+    }
+
+    if (rewind_async.cond) { SDL_DestroyCond(rewind_async.cond); }
+    if (rewind_async.mutex) { SDL_DestroyMutex(rewind_async.mutex); }
+
+    memset(&rewind_async, 0, sizeof(rewind_async));
+}
+
+static bool rewind_async_init(void)
+{
+    rewind_async_close();
+
+    rewind_async.mutex = SDL_CreateMutex();
+    rewind_async.cond = SDL_CreateCond();
+
+    if (rewind_async.mutex && rewind_async.cond)
+    {
+        rewind_async.thread = SDL_CreateThread(rewind_async_thread, "rewind", NULL);
+    }
+
+    if (!rewind_async.thread)
+    {
+        mgb_log_err("[MGB] failed to create rewind thread: %s\n", SDL_GetError());
+        rewind_async_close();
+        return false;
+    }
+
+    return true;
+}
+
+static bool rewind_async_push(const void* pixels, size_t size)
+{
+    SDL_LockMutex(rewind_async.mutex);
+    const unsigned count = rewind_async.count;
+    const unsigned head = rewind_async.head;
+    SDL_UnlockMutex(rewind_async.mutex);
+
+    // the worker isn't keeping up, drop the frame rather than stall,
+    // rewinding will just skip over it.
+    if (count == REWIND_ASYNC_SLOTS)
+    {
+        return false;
+    }
+
+    // the head slot isn't visible to the worker until count is bumped
+    struct RewindState* slot = &rewind_async.slots[head];
+
+    if (!GB_savestate(mgb.gb, &slot->state))
+    {
+        return false;
+    }
+
+    memcpy(slot->pixels, pixels, size);
+
+    SDL_LockMutex(rewind_async.mutex);
+    rewind_async.head = (head + 1) % REWIND_ASYNC_SLOTS;
+    rewind_async.count++;
+    SDL_CondSignal(rewind_async.cond);
+    SDL_UnlockMutex(rewind_async.mutex);
+
+    return true;
+}
+
+static bool rewind_async_pop(struct RewindState* out)
+{
+    bool result = false;
+
+    SDL_LockMutex(rewind_async.mutex);
+
+    // take the newest frame if the worker hasn't started on it yet
+    if (rewind_async.count > (rewind_async.busy ? 1u : 0u))
+    {
+        rewind_async.head = (rewind_async.head + REWIND_ASYNC_SLOTS - 1) % REWIND_ASYNC_SLOTS;
+        rewind_async.count--;
+        SDL_UnlockMutex(rewind_async.mutex);
+
+        // safe to read unlocked, the worker only takes the oldest slot
+        // and the producer (this thread) is the one popping.
+        memcpy(out, &rewind_async.slots[rewind_async.head], sizeof(*out));
+        return true;
+    }
+
+    // otherwise only wait if the frame we need is still being pushed
+    while (rewind_async.busy)
+    {
+        SDL_CondWait(rewind_async.cond, rewind_async.mutex);
+    }
+
+    result = rewind_pop(&rewinder, (uint8_t*)out, sizeof(*out));
+    SDL_UnlockMutex(rewind_async.mutex);
+
+    return result;
+}
+#endif // HAS_SDL2
+
+// uses a byte [budget] if set, otherwise sized for [seconds].
+static bool mgb_rewind_init_internal(size_t seconds, size_t budget)
+{
+#ifdef HAS_SDL2
+    rewind_async_close();
+#endif
+
+    rewind_close(&rewinder);
+
+    const bool result = budget ?
+        rewind_init_budget(&rewinder, budget, sizeof(rewind_state)) :
+        rewind_init(&rewinder, seconds, sizeof(rewind_state));
+
+    if (!result)
+    {
+        return false;
+    }
+
+    rewind_add_compressor(&rewinder, compressor_get(mgb.compressor));
+    return true;
+}
+
 bool mgb_rewind_init(size_t seconds)
 {
-    rewind_init(&rewinder, seconds);
-    rewind_add_compressor(&rewinder, Zlib, Zlib_size);
-    // rewind_add_compressor(&rewinder, Zstd, Zstd_size);
-    // rewind_add_compressor(&rewinder, Lz4, Lz4_size);
+    return mgb_rewind_init_internal(seconds, 0);
+}
+
+bool mgb_rewind_init_async(size_t seconds)
+{
+    if (!mgb_rewind_init_internal(seconds, 0))
+    {
+        return false;
+    }
+
+#ifdef HAS_SDL2
+    // not fatal, falls back to pushing on the calling thread
+    rewind_async_init();
+#endif
+
+    return true;
+}
+
+bool mgb_rewind_init_budget(size_t bytes)
+{
+    return bytes && mgb_rewind_init_internal(0, bytes);
+}
+
+bool mgb_rewind_init_budget_async(size_t bytes)
+{
+#ifdef HAS_SDL2
+    // the slots waiting to be pushed are part of the budget
+    if (bytes <= sizeof(rewind_async.slots))
+    {
+        return false;
+    }
+
+    bytes -= sizeof(rewind_async.slots);
+#endif
+
+    if (!mgb_rewind_init_budget(bytes))
+    {
+        return false;
+    }
+
+#ifdef HAS_SDL2
+    // not fatal, falls back to pushing on the calling thread
+    rewind_async_init();
+#endif
+
     return true;
 }
 
 void mgb_rewind_close(void)
 {
+#ifdef HAS_SDL2
+    rewind_async_close();
+#endif
+
     rewind_close(&rewinder);
 }
 
 // save states and stores pixel data for that frame
 bool mgb_rewind_push_frame(const void* pixels, size_t size)
 {
+#ifdef HAS_SDL2
+    if (rewind_async.thread)
+    {
+        return rewind_async_push(pixels, size);
+    }
+#endif
+
     if (GB_savestate(mgb.gb, &rewind_state.state))
     {
         memcpy(rewind_state.pixels, pixels, size);
@@ -645,7 +1233,20 @@ bool mgb_rewind_push_frame(const void* pixels, size_t size)
 // loads state and loads pixel data for that frame
 bool mgb_rewind_pop_frame(void* pixels, size_t size)
 {
-    if (rewind_pop(&rewinder, (uint8_t*)&rewind_state, sizeof(rewind_state)))
+    bool result = false;
+
+#ifdef HAS_SDL2
+    if (rewind_async.thread)
+    {
+        result = rewind_async_pop(&rewind_state);
+    }
+    else
+#endif
+    {
+        result = rewind_pop(&rewinder, (uint8_t*)&rewind_state, sizeof(rewind_state));
+    }
+
+    if (result)
     {
         if (GB_loadstate(mgb.gb, &rewind_state.state))
         {
@@ -656,3 +1257,270 @@ bool mgb_rewind_pop_frame(void* pixels, size_t size)
 
     return false;
 }
+
+// input log rewind, rather than a state per frame, a snapshot is taken
+// every [interval] frames and only the input is logged for each frame.
+// stepping back loads the nearest snapshot and re-runs the frames after
+// it, without rendering or audio, up to the frame before.
+struct RewindLogFrame
+{
+    // the slot is reused once the ring wraps, so this is checked on lookup.
+    size_t index;
+    uint32_t cycles;
+    uint32_t event_start; // index into events, wraps
+    uint8_t event_count;
+    uint8_t buttons;
+    struct GB_Rtc rtc;
+};
+
+static struct
+{
+    // older snapshots, the newest is kept in [anchor].
+    struct Rewind snapshots;
+    uint8_t* anchor;
+    size_t anchor_frame;
+    size_t state_size;
+    bool has_anchor;
+
+    struct RewindLogFrame* frames;
+    size_t frame_max;
+    struct GB_InputEvent* events;
+    uint32_t event_max;
+    uint32_t event_total;
+
+    size_t seconds;
+    size_t interval;
+    size_t position; // number of frames logged
+} rewind_log = {0};
+
+void mgb_rewind_log_close(void)
+{
+    rewind_close(&rewind_log.snapshots);
+
+    if (rewind_log.anchor) { free(rewind_log.anchor); }
+    if (rewind_log.frames) { free(rewind_log.frames); }
+    if (rewind_log.events) { free(rewind_log.events); }
+
+    memset(&rewind_log, 0, sizeof(rewind_log));
+}
+
+bool mgb_rewind_log_init(size_t seconds, size_t interval)
+{
+    mgb_rewind_log_close();
+
+    if (!mgb_has_rom() || !seconds || !interval)
+    {
+        return false;
+    }
+
+    rewind_log.seconds = seconds;
+    rewind_log.interval = interval;
+    rewind_log.state_size = GB_savestate_size(mgb.gb);
+
+    // the rewinder sizes for 1 entry per frame, but only 1 per interval is needed.
+    const size_t snapshots = (seconds * 60) / interval + 1;
+    const size_t groups = snapshots / REWIND_FRAME_ENTRY_COUNT + 1;
+
+    if (!rewind_init(&rewind_log.snapshots, groups * (REWIND_FRAME_ENTRY_COUNT / 60), rewind_log.state_size))
+    {
+        return false;
+    }
+
+    // the rewinder keeps whole groups, so it can hold more snapshots than
+    // asked for. the frames cover all of them, plus the anchor and the
+    // frames logged since, so a snapshot is never older than its frames.
+    const size_t snapshot_max = rewind_log.snapshots.max * REWIND_FRAME_ENTRY_COUNT;
+    rewind_log.frame_max = (snapshot_max + 2) * interval;
+    // every frame can have a full input queue.
+    rewind_log.event_max = (uint32_t)(rewind_log.frame_max * GB_INPUT_QUEUE_SIZE);
+
+    rewind_log.anchor = malloc(rewind_log.state_size);
+    rewind_log.frames = calloc(rewind_log.frame_max, sizeof(struct RewindLogFrame));
+    rewind_log.events = calloc(rewind_log.event_max, sizeof(struct GB_InputEvent));
+
+    if (!rewind_log.anchor || !rewind_log.frames || !rewind_log.events)
+    {
+        mgb_rewind_log_close();
+        return false;
+    }
+
+    rewind_add_compressor(&rewind_log.snapshots, compressor_get(mgb.compressor));
+    return true;
+}
+
+// the snapshots are a chain where each is [interval] frames before the
+// next, so one can't be skipped, the log is started again instead.
+static bool rewind_log_reset(void)
+{
+    const size_t seconds = rewind_log.seconds;
+    const size_t interval = rewind_log.interval;
+
+    return mgb_rewind_log_init(seconds, interval);
+}
+
+bool mgb_rewind_log_frame(uint32_t cycles)
+{
+    if (!rewind_log.frames)
+    {
+        return false;
+    }
+
+    if (rewind_log.position % rewind_log.interval == 0)
+    {
+        if (rewind_log.has_anchor && !rewind_push(&rewind_log.snapshots, rewind_log.anchor, rewind_log.state_size))
+        {
+            if (!rewind_log_reset())
+            {
+                return false;
+            }
+        }
+
+        rewind_log.has_anchor = GB_serialize_state(mgb.gb, rewind_log.anchor, rewind_log.state_size) != 0;
+        rewind_log.anchor_frame = rewind_log.position;
+
+        if (!rewind_log.has_anchor)
+        {
+            rewind_log_reset();
+            return false;
+        }
+    }
+
+    struct RewindLogFrame* frame = &rewind_log.frames[rewind_log.position % rewind_log.frame_max];
+    struct GB_InputEvent queued[GB_INPUT_QUEUE_SIZE];
+
+    frame->index = rewind_log.position;
+    frame->cycles = cycles;
+    frame->buttons = GB_get_buttons(mgb.gb);
+    frame->event_start = rewind_log.event_total;
+    frame->event_count = (uint8_t)GB_get_queued_buttons(mgb.gb, queued, GB_INPUT_QUEUE_SIZE);
+
+    if (!GB_get_rtc(mgb.gb, &frame->rtc))
+    {
+        memset(&frame->rtc, 0, sizeof(frame->rtc));
+    }
+
+    for (uint8_t i = 0; i < frame->event_count; i++)
+    {
+        rewind_log.events[rewind_log.event_total++ % rewind_log.event_max] = queued[i];
+    }
+
+    rewind_log.position++;
+    return true;
+}
+
+// the frame, or its events, may have been overwritten by newer ones.
+static bool rewind_log_has_frame(size_t index)
+{
+    const struct RewindLogFrame* frame = &rewind_log.frames[index % rewind_log.frame_max];
+
+    return index < rewind_log.position && frame->index == index &&
+        rewind_log.event_total - frame->event_start <= rewind_log.event_max;
+}
+
+static void rewind_log_replay_frame(size_t index)
+{
+    const struct RewindLogFrame* frame = &rewind_log.frames[index % rewind_log.frame_max];
+    const uint8_t buttons = GB_get_buttons(mgb.gb);
+    // the pins are low when pressed
+    const uint8_t pressed = buttons & ~frame->buttons;
+    const uint8_t released = frame->buttons & ~buttons;
+
+    if (released)
+    {
+        GB_set_buttons(mgb.gb, released, false);
+    }
+
+    if (pressed)
+    {
+        GB_set_buttons(mgb.gb, pressed, true);
+    }
+
+    GB_set_rtc(mgb.gb, frame->rtc);
+    GB_clear_input_queue(mgb.gb);
+
+    for (uint8_t i = 0; i < frame->event_count; i++)
+    {
+        const struct GB_InputEvent* event = &rewind_log.events[(frame->event_start + i) % rewind_log.event_max];
+        GB_queue_buttons(mgb.gb, event->cycle, event->buttons);
+    }
+
+    GB_run(mgb.gb, frame->cycles);
+}
+
+bool mgb_rewind_log_pop(void* pixels, uint32_t stride, uint8_t bpp)
+{
+    // the frame before the current one is re-run so that it's rendered,
+    // this leaves the core at the start of the current frame - 1.
+    if (!rewind_log.frames || rewind_log.position < 2)
+    {
+        return false;
+    }
+
+    const size_t target = rewind_log.position - 2;
+
+    if (!rewind_log.has_anchor)
+    {
+        return false;
+    }
+
+    // check everything that's needed before any snapshot is popped.
+    size_t pops = 0;
+
+    if (rewind_log.anchor_frame > target)
+    {
+        pops = (rewind_log.anchor_frame - target + rewind_log.interval - 1) / rewind_log.interval;
+    }
+
+    // the oldest snapshot has been reached
+    if (pops > rewind_count(&rewind_log.snapshots))
+    {
+        return false;
+    }
+
+    const size_t anchor_frame = rewind_log.anchor_frame - pops * rewind_log.interval;
+
+    for (size_t i = anchor_frame; i <= target; i++)
+    {
+        if (!rewind_log_has_frame(i))
+        {
+            return false;
+        }
+    }
+
+    // the snapshots are consumed by now, so the log can't be kept.
+    for (size_t i = 0; i < pops; i++)
+    {
+        if (!rewind_pop(&rewind_log.snapshots, rewind_log.anchor, rewind_log.state_size))
+        {
+            rewind_log_reset();
+            return false;
+        }
+    }
+
+    rewind_log.anchor_frame = anchor_frame;
+
+    if (!GB_deserialize_state(mgb.gb, rewind_log.anchor, rewind_log.state_size))
+    {
+        rewind_log_reset();
+        return false;
+    }
+
+    const unsigned freq = GB_get_apu_freq(mgb.gb);
+    GB_set_apu_freq(mgb.gb, 0);
+    GB_set_pixels(mgb.gb, NULL, 0, 0);
+
+    for (size_t i = rewind_log.anchor_frame; i <= target; i++)
+    {
+        if (i == target)
+        {
+            GB_set_pixels(mgb.gb, pixels, stride, bpp);
+        }
+
+        rewind_log_replay_frame(i);
+    }
+
+    GB_set_apu_freq(mgb.gb, freq);
+    rewind_log.position = target + 1;
+
+    return true;
+}
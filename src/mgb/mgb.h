@@ -8,6 +8,8 @@ extern "C" {
 #include <stdint.h>
 #include <stddef.h>
 
+#include "compressors.h"
+
 #ifdef HAS_SDL2
     #include "sdl_helper.h"
 #endif
@@ -29,6 +31,12 @@ void mgb_exit(void);
 
 void mgb_set_on_file_callback(void (*cb)(const char*, enum CallbackType, bool));
 
+// the compressor used for save states and rewind, default is zlib.
+// returns false if mgb was built without it.
+// rewind only picks this up on its next init.
+bool mgb_set_compressor(enum CompressorType type);
+enum CompressorType mgb_get_compressor(void);
+
 void mgb_set_save_folder(const char* path);
 void mgb_set_rtc_folder(const char* path);
 void mgb_set_state_folder(const char* path);
@@ -60,10 +68,29 @@ bool mgb_save_save_file(const char* path);
 bool mgb_save_rtc_file(const char* path);
 bool mgb_save_state_file(const char* path);
 
+// maps the save file into memory and uses it as the sram, so the game
+// writes straight to the file and saving only needs a flush.
+// applies from the next rom load, falls back to the normal save if
+// mapping isn't supported / fails.
+void mgb_set_save_mmap(bool enable);
+// call periodically (ie, once a second), only does anything if the game
+// wrote to sram since the last call. a mapped save is flushed on a worker
+// thread, otherwise the save file is written.
+// returns true if a save / flush was started.
+bool mgb_sync_save(void);
+
 // return true if rom is loaded
 bool mgb_has_rom(void);
 
 bool mgb_rewind_init(size_t seconds);
+// same as above, but frames are compressed on a worker thread, so a push
+// only costs a savestate + copy. falls back to sync if threads aren't
+// available. pop / push must be called from the same thread.
+bool mgb_rewind_init_async(size_t seconds);
+// same as above, but all rewind memory is limited to [bytes], the oldest
+// frames are evicted to stay within it. the async slots count towards it.
+bool mgb_rewind_init_budget(size_t bytes);
+bool mgb_rewind_init_budget_async(size_t bytes);
 void mgb_rewind_close(void);
 
 // save states and stores pixel data for that frame
@@ -71,6 +98,20 @@ bool mgb_rewind_push_frame(const void* pixels, size_t size);
 // loads state and loads pixel data for that frame
 bool mgb_rewind_pop_frame(void* pixels, size_t size);
 
+// input log rewind, a snapshot is taken every [interval] frames and only the
+// input is logged in between, this uses far less memory than the above.
+// stepping back re-runs up to [interval] frames, so keep it small, ie, 30.
+// must be called after a rom is loaded (and again after changing rom).
+bool mgb_rewind_log_init(size_t seconds, size_t interval);
+void mgb_rewind_log_close(void);
+// call right before running each frame, after the input / rtc are set.
+// [cycles] is how many cycles the frame is run for.
+bool mgb_rewind_log_frame(uint32_t cycles);
+// steps back 1 frame, which is rendered into [pixels], these are
+// then left set on the core. if a snapshot fails to be stored or loaded,
+// the log is started again from the current frame.
+bool mgb_rewind_log_pop(void* pixels, uint32_t stride, uint8_t bpp);
+
 // // event
 // enum MgbEventMouseButton {
 //     MgbEventMouseButton_NONE = 0,
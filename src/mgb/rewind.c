@@ -7,95 +7,175 @@
 #include <assert.h>
 // #include <stdio.h>
 
-// matching data gets xored to 0, which compresses really well
-static void xor(const uint8_t* keydata, size_t keysize, uint8_t* frame, size_t framesize)
+// the rle works on 8 bytes at a time, the frame is split into runs of
+// zero words (after xor) followed by a run of literal words.
+// each pair of runs has a header of 2 u32 (zero count, literal count).
+// any bytes left over (size % 8) are stored xored at the end.
+typedef uint64_t rle_word_t;
+
+enum
 {
-    assert(keysize == framesize && "[XOR] key and frame size doe not match, this is unsupported");
+    RLE_WORD_SIZE = sizeof(rle_word_t),
+    RLE_HEADER_SIZE = sizeof(uint32_t) * 2,
+};
 
-    for (size_t i = 0; i < keysize; i++)
-    {
-        frame[i] ^= keydata[i];
-    }
+// memcpy so that the frame / arena don't need to be aligned,
+// this compiles to a single load / store.
+static inline rle_word_t rle_load(const uint8_t* p)
+{
+    rle_word_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
 }
 
-// allocates new data for keyframe
-static void rewindframe_init(struct RewindFrame* rwf, const uint8_t* keydata, size_t keysize)
+static inline void rle_store(uint8_t* p, rle_word_t w)
 {
-    memset(rwf, 0, sizeof(struct RewindFrame));
+    memcpy(p, &w, sizeof(w));
+}
 
-    rwf->keyframe.data = malloc(keysize);
-    rwf->keyframe.size = keysize;
-    memcpy(rwf->keyframe.data, keydata, keysize);
+// a literal run only ends at 2 zero words in a row, so the worst
+// case is 1 header per 3 words.
+static size_t rle_bound(size_t size)
+{
+    return size + RLE_HEADER_SIZE * (size / (RLE_WORD_SIZE * 3) + 2);
 }
 
-static void rewindframe_close(struct RewindFrame* rwf)
+// xors [frame] against [last] and encodes that into [dst], which must be
+// at least rle_bound() in size. [last] is then updated to [frame].
+static size_t rle_encode(uint8_t* dst, uint8_t* last, const uint8_t* frame, size_t size)
 {
-    if (rwf->keyframe.data)
+    const size_t words = size / RLE_WORD_SIZE;
+    size_t out = 0;
+    size_t i = 0;
+
+    while (i < words)
     {
-        free(rwf->keyframe.data);
+        const size_t zero_start = i;
+
+        while (i < words && rle_load(frame + i * RLE_WORD_SIZE) == rle_load(last + i * RLE_WORD_SIZE))
+        {
+            i++;
+        }
+
+        const size_t literal_start = i;
+
+        while (i < words)
+        {
+            const size_t offset = i * RLE_WORD_SIZE;
+
+            if (rle_load(frame + offset) == rle_load(last + offset))
+            {
+                if (i + 1 >= words || rle_load(frame + offset + RLE_WORD_SIZE) == rle_load(last + offset + RLE_WORD_SIZE))
+                {
+                    break;
+                }
+            }
+
+            i++;
+        }
+
+        const uint32_t header[2] = { (uint32_t)(literal_start - zero_start), (uint32_t)(i - literal_start) };
+        memcpy(dst + out, header, sizeof(header));
+        out += sizeof(header);
+
+        for (size_t j = literal_start; j < i; j++)
+        {
+            const size_t offset = j * RLE_WORD_SIZE;
+            const rle_word_t w = rle_load(frame + offset);
+
+            rle_store(dst + out, w ^ rle_load(last + offset));
+            rle_store(last + offset, w);
+            out += RLE_WORD_SIZE;
+        }
     }
 
-    for (size_t i = 0; i < rwf->count; i++)
+    for (size_t j = words * RLE_WORD_SIZE; j < size; j++)
     {
-        assert(rwf->data[i].data);
-        free(rwf->data[i].data);
+        dst[out++] = frame[j] ^ last[j];
+        last[j] = frame[j];
     }
 
-    memset(rwf, 0, sizeof(struct RewindFrame));
-}
-
-static bool rewindframe_is_empty(const struct RewindFrame* rwf)
-{
-    return rwf->count == 0;
+    return out;
 }
 
-static bool rewindframe_is_full(const struct RewindFrame* rwf)
+// xors the encoded frame back into [last].
+static bool rle_decode(uint8_t* last, size_t size, const uint8_t* src, size_t src_size)
 {
-    return rwf->count == REWIND_FRAME_ENTRY_COUNT;
-}
+    const size_t words = size / RLE_WORD_SIZE;
+    const size_t tail = size % RLE_WORD_SIZE;
+    size_t in = 0;
+    size_t i = 0;
 
-static bool rewindframe_push(struct RewindFrame* rwf, const uint8_t* framedata, size_t framesize, rewind_compressor_func_t compressor, rewind_compressor_size_func_t compressor_size)
-{
-    // we can't push any more frames!
-    assert(rewindframe_is_full(rwf) == false && "[RWF] tried to push frame when full");
+    while (i < words)
+    {
+        uint32_t header[2];
 
-    uint8_t* compressed_data = (uint8_t*)malloc(framesize);
-    size_t compressed_size = framesize;
-    memcpy(compressed_data, framedata, framesize);
+        if (src_size - in < sizeof(header))
+        {
+            return false;
+        }
 
-    xor(rwf->keyframe.data, rwf->keyframe.size, compressed_data, framesize);
+        memcpy(header, src + in, sizeof(header));
+        in += sizeof(header);
 
-    if (compressor && compressor_size)
-    {
-        compressed_size = compressor_size(framesize);
-        void* buf = malloc(compressed_size);
+        if (header[0] > words - i || header[1] > words - i - header[0] || (size_t)header[1] * RLE_WORD_SIZE > src_size - in)
+        {
+            return false;
+        }
 
-        memcpy(buf, compressed_data, framesize);
-        compressed_size = compressor(buf, compressed_size, compressed_data, framesize, 0);
+        i += header[0];
 
-        if (compressed_size == (size_t)-1)
+        for (uint32_t j = 0; j < header[1]; j++, i++)
         {
-            assert(compressed_size && "failed to compress");
-            free(compressed_data);
-            free(buf);
-            return false;
+            const size_t offset = i * RLE_WORD_SIZE;
+
+            rle_store(last + offset, rle_load(last + offset) ^ rle_load(src + in));
+            in += RLE_WORD_SIZE;
         }
+    }
 
-        free(compressed_data);
-        compressed_data = realloc(buf, compressed_size);
-        // printf("compress result: %zu\n", compressed_size);
+    if (src_size - in != tail)
+    {
+        return false;
     }
 
-    rwf->data[rwf->count].data = compressed_data;
+    for (size_t j = 0; j < tail; j++)
+    {
+        last[words * RLE_WORD_SIZE + j] ^= src[in + j];
+    }
+
+    return true;
+}
+
+static void rewindframe_close(struct RewindFrame* rwf)
+{
+    memset(rwf, 0, sizeof(struct RewindFrame));
+}
+
+static bool rewindframe_is_empty(const struct RewindFrame* rwf)
+{
+    return rwf->count == 0;
+}
+
+static bool rewindframe_is_full(const struct RewindFrame* rwf, size_t group_entries)
+{
+    return rwf->count >= group_entries;
+}
+
+static void rewindframe_push(struct RewindFrame* rwf, uint8_t* data, size_t compressed_size, size_t framesize)
+{
+    // we can't push any more frames!
+    assert(rwf->count < REWIND_FRAME_ENTRY_COUNT && "[RWF] tried to push frame when full");
+
+    rwf->data[rwf->count].data = data;
     rwf->data[rwf->count].size = framesize;
     rwf->data[rwf->count].compressed_size = compressed_size;
-    assert(rwf->data[rwf->count].size && rwf->data[rwf->count].compressed_size);
+    rwf->bytes += compressed_size;
     rwf->count++;
-
-    return true;
 }
 
-static bool rewindframe_pop(struct RewindFrame* rwf, uint8_t* outdata, size_t outsize, rewind_compressor_func_t compressor)
+// outputs [last], then steps [last] back to the frame before it.
+static bool rewindframe_pop(struct RewindFrame* rwf, uint8_t* last, uint8_t* scratch, size_t scratch_size, uint8_t* outdata, size_t outsize, rewind_compressor_func_t compressor)
 {
     // can't pop any more frames!
     assert(rewindframe_is_empty(rwf) == false && "[RWF] tried to pop frame when empty");
@@ -108,43 +188,234 @@ static bool rewindframe_pop(struct RewindFrame* rwf, uint8_t* outdata, size_t ou
         return false;
     }
 
+    const uint8_t* encoded = entry->data;
+    size_t encoded_size = entry->compressed_size;
+
     if (compressor)
     {
-        const size_t result = compressor(outdata, outsize, entry->data, entry->compressed_size, 1);
-        assert(result && "failed to decompress");
-        // printf("decompress result: %zu size: %zu\n", result, outsize);
+        encoded_size = compressor(scratch, scratch_size, entry->data, entry->compressed_size, 1);
+        encoded = scratch;
+
+        if (encoded_size == (size_t)-1)
+        {
+            assert(!"failed to decompress");
+            return false;
+        }
+        // printf("decompress result: %zu size: %zu\n", encoded_size, outsize);
     }
-    else
+
+    memcpy(outdata, last, outsize);
+
+    if (!rle_decode(last, outsize, encoded, encoded_size))
     {
-        memcpy(outdata, entry->data, outsize);
+        assert(!"failed to decode");
+        return false;
     }
 
-    xor(rwf->keyframe.data, rwf->keyframe.size, outdata, outsize);
-
-    free(entry->data);
+    rwf->bytes -= entry->compressed_size;
     memset(entry, 0, sizeof(struct RewindFrameEntry));
 
     rwf->count--;
     return true;
 }
 
+// the space given to the compressor for an entry, extra for its worst case.
+static size_t rewind_entry_bound(size_t size)
+{
+    return size + size / 64 + 0x400;
+}
+
 static size_t rewind_calculate_seconds(size_t seconds_wanted)
 {
     size_t a = REWIND_FRAME_ENTRY_COUNT / 60;
     return seconds_wanted < a ? a : seconds_wanted / a;
 }
 
-bool rewind_init(struct Rewind* rw, size_t seconds)
+// enough for the expected size of every entry in a group, but always
+// with room for at least 1 entry that didn't compress at all.
+static size_t rewind_calculate_group_size(size_t frame_size)
+{
+    const size_t expected = (frame_size / REWIND_EXPECTED_RATIO) * REWIND_FRAME_ENTRY_COUNT;
+    const size_t minimum = rewind_entry_bound(rle_bound(frame_size));
+
+    return expected > minimum ? expected : minimum;
+}
+
+static size_t rewind_oldest(const struct Rewind* rw)
+{
+    return (rw->index + rw->max - (rw->count - 1)) % rw->max;
+}
+
+static void rewind_evict_oldest(struct Rewind* rw)
+{
+    // never drop the group being pushed to, only its oldest entry
+    if (rw->count == 1)
+    {
+        struct RewindFrame* rwf = &rw->frames[rw->index];
+
+        rwf->bytes -= rwf->data[0].compressed_size;
+        rwf->count--;
+        memmove(rwf->data, rwf->data + 1, rwf->count * sizeof(struct RewindFrameEntry));
+        memset(&rwf->data[rwf->count], 0, sizeof(struct RewindFrameEntry));
+    }
+    else
+    {
+        rewindframe_close(&rw->frames[rewind_oldest(rw)]);
+        rw->count--;
+    }
+}
+
+// finds [size] bytes in the arena, evicting the oldest groups until
+// it fits. the arena is always big enough for the largest entry.
+static uint8_t* rewind_reserve(struct Rewind* rw, size_t size)
 {
-    if (!rw || !seconds)
+    assert(size <= rw->arena_size);
+
+    for (;;)
+    {
+        const struct RewindFrame* oldest = &rw->frames[rewind_oldest(rw)];
+
+        // the only group is the one being pushed to and it's empty
+        if (rewindframe_is_empty(oldest))
+        {
+            rw->arena_head = 0;
+            return rw->arena;
+        }
+
+        const size_t head = rw->arena_head;
+        const size_t tail = (size_t)(oldest->data[0].data - rw->arena);
+
+        if (tail < head)
+        {
+            // the free space is after the head, or wrapped to before the tail
+            if (head + size <= rw->arena_size)
+            {
+                return rw->arena + head;
+            }
+
+            if (size <= tail)
+            {
+                rw->arena_head = 0;
+                return rw->arena;
+            }
+        }
+        // the free space is between the head and the tail
+        else if (head + size <= tail)
+        {
+            return rw->arena + head;
+        }
+
+        rewind_evict_oldest(rw);
+    }
+}
+
+// when using a budget, the group size is picked from the average
+// entry size, so that the budget is split evenly between the max groups.
+static void rewind_update_group_entries(struct Rewind* rw)
+{
+    size_t entries = rw->arena_size / rw->max / rw->average_entry_size;
+    entries = entries < 1 ? 1 : entries;
+    entries = entries > REWIND_FRAME_ENTRY_COUNT ? REWIND_FRAME_ENTRY_COUNT : entries;
+
+    rw->group_entries = entries;
+}
+
+// the average is updated from each group as it fills up.
+static void rewind_adapt_group_entries(struct Rewind* rw, const struct RewindFrame* rwf)
+{
+    if (rewindframe_is_empty(rwf))
+    {
+        return;
+    }
+
+    const size_t average = rwf->bytes / rwf->count + 1;
+    rw->average_entry_size = (rw->average_entry_size * 3 + average) / 4 + 1;
+    rewind_update_group_entries(rw);
+}
+
+static void rewind_next_group(struct Rewind* rw)
+{
+    if (rw->count)
+    {
+        if (rw->adaptive)
+        {
+            rewind_adapt_group_entries(rw, &rw->frames[rw->index]);
+        }
+
+        // every group is used, drop the oldest
+        if (rw->count == rw->max)
+        {
+            rewindframe_close(&rw->frames[rewind_oldest(rw)]);
+            rw->count--;
+        }
+
+        rw->index = (rw->index + 1) % rw->max;
+    }
+
+    rewindframe_close(&rw->frames[rw->index]);
+    rw->count++;
+}
+
+static bool rewind_alloc(struct Rewind* rw, size_t max, size_t arena_size, size_t frame_size)
+{
+    rw->max = max;
+    rw->frame_size = frame_size;
+    rw->arena_size = arena_size;
+    rw->group_entries = REWIND_FRAME_ENTRY_COUNT;
+    rw->average_entry_size = frame_size / REWIND_EXPECTED_RATIO + 1;
+    rw->frames = calloc(rw->max, sizeof(struct RewindFrame));
+    rw->arena = malloc(rw->arena_size);
+    // the first frame is xored against zero
+    rw->last = calloc(1, frame_size);
+    rw->scratch = malloc(rle_bound(frame_size));
+
+    if (!rw->frames || !rw->arena || !rw->last || !rw->scratch)
+    {
+        rewind_close(rw);
+        return false;
+    }
+
+    return true;
+}
+
+bool rewind_init(struct Rewind* rw, size_t seconds, size_t frame_size)
+{
+    if (!rw || !seconds || !frame_size)
     {
         return false;
     }
 
     memset(rw, 0, sizeof(struct Rewind));
 
-    rw->max = rewind_calculate_seconds(seconds);
-    rw->frames = calloc(rw->max, sizeof(struct RewindFrame));
+    const size_t max = rewind_calculate_seconds(seconds);
+    return rewind_alloc(rw, max, max * rewind_calculate_group_size(frame_size), frame_size);
+}
+
+bool rewind_init_budget(struct Rewind* rw, size_t budget, size_t frame_size)
+{
+    if (!rw || !budget || !frame_size)
+    {
+        return false;
+    }
+
+    memset(rw, 0, sizeof(struct Rewind));
+
+    const size_t max = REWIND_BUDGET_GROUP_COUNT;
+    const size_t overhead = max * sizeof(struct RewindFrame) + frame_size + rle_bound(frame_size);
+    const size_t minimum = rewind_entry_bound(rle_bound(frame_size));
+
+    if (budget < overhead || budget - overhead < minimum)
+    {
+        return false;
+    }
+
+    if (!rewind_alloc(rw, max, budget - overhead, frame_size))
+    {
+        return false;
+    }
+
+    rw->adaptive = true;
+    rewind_update_group_entries(rw);
 
     return true;
 }
@@ -153,21 +424,30 @@ void rewind_close(struct Rewind* rw)
 {
     if (rw->frames)
     {
-        for (size_t i = 0; i < rw->count; i++)
-        {
-            rewindframe_close(&rw->frames[i]);
-        }
-
         free(rw->frames);
     }
 
+    if (rw->arena)
+    {
+        free(rw->arena);
+    }
+
+    if (rw->last)
+    {
+        free(rw->last);
+    }
+
+    if (rw->scratch)
+    {
+        free(rw->scratch);
+    }
+
     memset(rw, 0, sizeof(*rw));
 }
 
-void rewind_add_compressor(struct Rewind* rw, rewind_compressor_func_t compressor, rewind_compressor_size_func_t size)
+void rewind_add_compressor(struct Rewind* rw, rewind_compressor_func_t compressor)
 {
     rw->compressor = compressor;
-    rw->compressor_size = size;
 }
 
 bool rewind_pop(struct Rewind* rw, uint8_t* data, size_t size)
@@ -178,41 +458,81 @@ check_again:
         return false;
     }
 
-    if (rw->frames[rw->index].count == 0)
+    struct RewindFrame* rwf = &rw->frames[rw->index];
+
+    if (rewindframe_is_empty(rwf))
     {
-        rewindframe_close(&rw->frames[rw->index]);
+        rewindframe_close(rwf);
         rw->index = rw->index ? rw->index - 1 : rw->max - 1;
         rw->count--;
+
+        if (rw->count == 0)
+        {
+            rw->arena_head = 0;
+        }
         goto check_again;
     }
 
-    return rewindframe_pop(&rw->frames[rw->index], data, size, rw->compressor);
+    // the popped entry is always the newest in the arena
+    const size_t offset = (size_t)(rwf->data[rwf->count - 1].data - rw->arena);
+
+    if (!rewindframe_pop(rwf, rw->last, rw->scratch, rle_bound(rw->frame_size), data, size, rw->compressor))
+    {
+        return false;
+    }
+
+    rw->arena_head = offset;
+    return true;
 }
 
 bool rewind_push(struct Rewind* rw, const uint8_t* data, size_t size)
 {
-    bool new_keyframe = false;
+    if (!rw->frames || size != rw->frame_size)
+    {
+        return false;
+    }
+
+    const size_t encoded_size = rle_encode(rw->scratch, rw->last, data, size);
 
-    // we are at the start
-    if (rewindframe_is_empty(&rw->frames[rw->index]))
+    if (rw->count == 0 || rewindframe_is_full(&rw->frames[rw->index], rw->group_entries))
     {
-        new_keyframe = true;
+        rewind_next_group(rw);
     }
-    // we are at the end
-    else if (rewindframe_is_full(&rw->frames[rw->index]))
+
+    const size_t bound = rw->compressor ? rewind_entry_bound(encoded_size) : encoded_size;
+    uint8_t* dst = rewind_reserve(rw, bound);
+    size_t stored_size = encoded_size;
+
+    if (rw->compressor)
     {
-        rw->index = (rw->index + 1) % (rw->max);
-        new_keyframe = true;
+        stored_size = rw->compressor(dst, bound, rw->scratch, encoded_size, 0);
+
+        if (stored_size == (size_t)-1 || stored_size == 0)
+        {
+            // undo the encode so that the older entries still line up
+            rle_decode(rw->last, size, rw->scratch, encoded_size);
+            return false;
+        }
+    }
+    else
+    {
+        memcpy(dst, rw->scratch, encoded_size);
     }
 
-    // push new keyframe
-    if (new_keyframe)
+    rewindframe_push(&rw->frames[rw->index], dst, stored_size, size);
+    rw->arena_head = (size_t)(dst - rw->arena) + stored_size;
+
+    return true;
+}
+
+size_t rewind_count(const struct Rewind* rw)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < rw->count; i++)
     {
-        rewindframe_close(&rw->frames[rw->index]);
-        rewindframe_init(&rw->frames[rw->index], data, size);
-        rw->count = rw->count < rw->max ? rw->count + 1 : rw->max;
+        count += rw->frames[(rw->index + rw->max - i) % rw->max].count;
     }
 
-    // push new entry
-    return rewindframe_push(&rw->frames[rw->index], data, size, rw->compressor, rw->compressor_size);
+    return count;
 }
@@ -9,9 +9,26 @@
     #define REWIND_FRAME_ENTRY_COUNT 120
 #endif
 
-typedef size_t (*rewind_compressor_size_func_t)(size_t src_size);
+// the expected size of a compressed frame is frame_size / ratio,
+// this is used to size the arena, and as the starting guess for
+// the group size when using a byte budget.
+#ifndef REWIND_EXPECTED_RATIO
+    #define REWIND_EXPECTED_RATIO 64
+#endif
+
+// how many groups a byte budget is split into, the oldest group is
+// evicted when the budget is reached, so this is the granularity.
+#ifndef REWIND_BUDGET_GROUP_COUNT
+    #define REWIND_BUDGET_GROUP_COUNT 16
+#endif
+
+// returns the compressed / decompressed size, or (size_t)-1 on error,
+// ie, if dst_size is too small.
 typedef size_t (*rewind_compressor_func_t)(void* dst_data, size_t dst_size, const void* src_data, size_t src_size, int mode);
 
+// each frame is stored as the xor against the frame before it, with runs
+// of zero words removed (rle). this can then be optionally compressed.
+// to step back, the entry is xored against the newest frame.
 struct RewindFrameEntry
 {
     uint8_t* data;
@@ -22,26 +39,48 @@ struct RewindFrameEntry
 
 struct RewindFrame
 {
-    struct RewindFrameEntry keyframe;
     struct RewindFrameEntry data[REWIND_FRAME_ENTRY_COUNT]; // todo: make adjustable
     size_t count;
-    bool keyframe_compressed;
+    // total compressed size of all entries.
+    size_t bytes;
 };
 
 struct Rewind
 {
     rewind_compressor_func_t compressor;
-    rewind_compressor_size_func_t compressor_size;
     struct RewindFrame* frames;
+    // all entries are stored here as a ring, oldest groups are evicted
+    // to make room, so a push / pop never allocates.
+    uint8_t* arena;
+    size_t arena_size;
+    size_t arena_head; // where the next entry is written
+    // the newest frame, entries are xored against this.
+    uint8_t* last;
+    // the rle is written here before being compressed.
+    uint8_t* scratch;
+    size_t frame_size;
     size_t index; // which frame we are currently in
     size_t count; // how many frames we have allocated
     size_t max; // max frames
+    // entries per group, fixed unless using a byte budget.
+    size_t group_entries;
+    // average compressed entry size, used to pick group_entries.
+    size_t average_entry_size;
+    bool adaptive;
 };
 
-bool rewind_init(struct Rewind* rw, size_t seconds_wanted);
+// allocates everything up front, each push must be [frame_size].
+bool rewind_init(struct Rewind* rw, size_t seconds_wanted, size_t frame_size);
+// same as above, but all memory used (excluding rw itself) is limited to
+// [budget] bytes. the oldest frames are evicted to stay within it.
+// fails if the budget can't fit at least 1 uncompressed frame.
+bool rewind_init_budget(struct Rewind* rw, size_t budget, size_t frame_size);
 void rewind_close(struct Rewind* rw);
 
-void rewind_add_compressor(struct Rewind* rw, rewind_compressor_func_t compressor, rewind_compressor_size_func_t size);
+// optional, compresses the rle output, ie, zlib.
+void rewind_add_compressor(struct Rewind* rw, rewind_compressor_func_t compressor);
 
 bool rewind_pop(struct Rewind* rw, uint8_t* data, size_t size);
 bool rewind_push(struct Rewind* rw, const uint8_t* data, size_t size);
+// how many frames can be popped.
+size_t rewind_count(const struct Rewind* rw);
@@ -4,6 +4,7 @@
 #include "ifile/cfile/cfile.h"
 #include "ifile/zip/zip.h"
 #include "ifile/mem/mem.h"
+#include "ifile/mmap/mmap.h"
 
 
 IFile_t* romloader_open(const char* path)
@@ -22,6 +23,18 @@ IFile_t* romloader_open(const char* path)
     return NULL;
 }
 
+IFile_t* romloader_open_mmap(const char* path)
+{
+    const enum ExtensionType type = util_get_extension_type(path, ExtensionOffsetType_LAST);
+
+    if (type == ExtensionType_ROM)
+    {
+        return immap_open(path, IFileMode_READ, 0);
+    }
+
+    return NULL;
+}
+
 IFile_t* romloader_open_fd(int fd, bool own, const char* path)
 {
     const enum ExtensionType type = util_get_extension_type(path, ExtensionOffsetType_LAST);
@@ -17,6 +17,10 @@ IFile_t* romloader_open(const char* path);
 // if own is false, dup will be called
 IFile_t* romloader_open_fd(int fd, bool own, const char* path);
 
+// only for plain roms on disk, the data can be fetched with immap_get_data()
+// and used without copying. returns NULL otherwise, so use romloader_open().
+IFile_t* romloader_open_mmap(const char* path);
+
 //
 IFile_t* romloader_open_mem(const char* path, const void* data, size_t size);
 
@@ -0,0 +1,94 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// lock-free triple buffer, header only so that ports which don't link
+// mgb (ie, libretro) can still use it.
+//
+// the producer (the core) always has a free buffer to render into and
+// the consumer (the renderer) always takes the newest complete frame.
+// the two only ever share the "middle" index, which is swapped atomically.
+//
+// there must only be 1 producer and 1 consumer thread.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define TRIPLE_BUFFER_EXCHANGE(ptr, v) _InterlockedExchange((volatile long*)(ptr), (long)(v))
+    #define TRIPLE_BUFFER_LOAD(ptr) _InterlockedOr((volatile long*)(ptr), 0)
+#else
+    #define TRIPLE_BUFFER_EXCHANGE(ptr, v) __atomic_exchange_n((ptr), (v), __ATOMIC_ACQ_REL)
+    #define TRIPLE_BUFFER_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
+enum
+{
+    // set in [middle] when the producer has published a frame
+    // that the consumer hasn't yet taken.
+    TRIPLE_BUFFER_DIRTY = 1 << 2,
+    TRIPLE_BUFFER_INDEX_MASK = 0x3,
+};
+
+struct TripleBuffer
+{
+    void* buffers[3];
+    // only accessed by the producer
+    long back;
+    // only accessed by the consumer
+    long front;
+    // shared, index | TRIPLE_BUFFER_DIRTY
+    long middle;
+};
+
+static inline void triple_buffer_init(struct TripleBuffer* tb, void* a, void* b, void* c)
+{
+    tb->buffers[0] = a;
+    tb->buffers[1] = b;
+    tb->buffers[2] = c;
+    tb->back = 0;
+    tb->middle = 1;
+    tb->front = 2;
+}
+
+// the buffer the producer should render into.
+static inline void* triple_buffer_back(const struct TripleBuffer* tb)
+{
+    return tb->buffers[tb->back];
+}
+
+// called by the producer once the back buffer is a complete frame.
+// returns the new back buffer to render into.
+static inline void* triple_buffer_publish(struct TripleBuffer* tb)
+{
+    const long old = TRIPLE_BUFFER_EXCHANGE(&tb->middle, tb->back | TRIPLE_BUFFER_DIRTY);
+    tb->back = old & TRIPLE_BUFFER_INDEX_MASK;
+    return tb->buffers[tb->back];
+}
+
+// called by the consumer, returns true if a new frame was taken.
+// the frame is then in triple_buffer_front().
+static inline bool triple_buffer_acquire(struct TripleBuffer* tb)
+{
+    if (!(TRIPLE_BUFFER_LOAD(&tb->middle) & TRIPLE_BUFFER_DIRTY))
+    {
+        return false;
+    }
+
+    const long old = TRIPLE_BUFFER_EXCHANGE(&tb->middle, tb->front);
+    tb->front = old & TRIPLE_BUFFER_INDEX_MASK;
+    return true;
+}
+
+// the newest frame taken by the consumer.
+static inline void* triple_buffer_front(const struct TripleBuffer* tb)
+{
+    return tb->buffers[tb->front];
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #include "libretro.h"
 #include "types.h"
 #include <gb.h>
+#include <triple_buffer.h>
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -14,14 +15,20 @@ enum
     SAMPLE_RATE = 48000,
     FRAMEBUFFER_W = GB_SCREEN_WIDTH,
     FRAMEBUFFER_H = GB_SCREEN_HEIGHT,
+    MAX_RUNAHEAD = 4,
 };
 
 
 static struct GB_Core gb = {0};
 
 // double buffered
-static uint16_t* framebuffers[2] = {0};
-static uint8_t framebuffer_index = 0;
+static uint16_t* framebuffers[3] = {0};
+static struct TripleBuffer video = {0};
+// only the frame from the furthest run-ahead frame is presented
+static bool present_frames = true;
+static int runahead = 0;
+// static as it's large and is saved / loaded every frame when running ahead
+static struct GB_State runahead_state;
 
 static uint8_t rom_data[GB_ROM_SIZE_MAX] = {0};
 static size_t rom_size = 0;
@@ -67,25 +74,26 @@ static void core_on_vblank(void* user)
 {
     (void)user;
 
-    framebuffer_index ^= 1;
-    GB_set_pixels(&gb, framebuffers[framebuffer_index], FRAMEBUFFER_W, 16);
+    // keep drawing into the same back buffer
+    if (!present_frames)
+    {
+        return;
+    }
+
+    GB_set_pixels(&gb, triple_buffer_publish(&video), FRAMEBUFFER_W, 16);
 }
 
-static void core_on_apu(void* user, struct GB_ApuCallbackData* data)
+static void core_on_apu(void* user, const int16_t* samples, uint32_t frames)
 {
     (void)user;
 
-    const uint8_t left = (data->ch1[0] + data->ch2[0] + data->ch3[0] + data->ch4[0]) / 4;
-    const uint8_t right = (data->ch1[1] + data->ch2[1] + data->ch3[1] + data->ch4[1]) / 4;
-
-    // convert from u8 to s16 (untested, pretty sure its right tho)
-    audio_cb((left ^ 0x80) << 8, (right ^ 0x80) << 8);
+    audio_batch_cb(samples, frames);
 }
 
 void retro_init(void)
 {
     GB_init(&gb);
-    GB_set_apu_callback(&gb, core_on_apu, NULL, SAMPLE_RATE);
+    GB_set_apu_block_callback(&gb, core_on_apu, NULL, SAMPLE_RATE, 0);
     GB_set_vblank_callback(&gb, core_on_vblank, NULL);
     GB_set_colour_callback(&gb, core_on_colour, NULL);
 }
@@ -113,8 +121,10 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
 {
     framebuffers[0] = calloc(FRAMEBUFFER_W * FRAMEBUFFER_H, sizeof(uint16_t));
     framebuffers[1] = calloc(FRAMEBUFFER_W * FRAMEBUFFER_H, sizeof(uint16_t));
+    framebuffers[2] = calloc(FRAMEBUFFER_W * FRAMEBUFFER_H, sizeof(uint16_t));
 
-    GB_set_pixels(&gb, framebuffers[framebuffer_index], FRAMEBUFFER_W, 16);
+    triple_buffer_init(&video, framebuffers[0], framebuffers[1], framebuffers[2]);
+    GB_set_pixels(&gb, triple_buffer_back(&video), FRAMEBUFFER_W, 16);
 
     info->timing.fps = FPS;
     info->timing.sample_rate = SAMPLE_RATE;
@@ -129,9 +139,27 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
     environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &pixel_format);
 }
 
+static void check_variables(void)
+{
+    struct retro_variable var = { .key = "totalgb_runahead", .value = NULL };
+
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+    {
+        runahead = atoi(var.value);
+        runahead = runahead < 0 ? 0 : runahead > MAX_RUNAHEAD ? MAX_RUNAHEAD : runahead;
+    }
+}
+
 void retro_set_environment(retro_environment_t cb)
 {
+    static struct retro_variable variables[] =
+    {
+        { "totalgb_runahead", "Run-ahead frames; 0|1|2|3|4" },
+        { NULL, NULL },
+    };
+
     environ_cb = cb;
+    environ_cb(RETRO_ENVIRONMENT_SET_VARIABLES, variables);
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb)
@@ -174,17 +202,17 @@ void retro_cheat_set(unsigned index, bool enabled, const char *code)
 // savestate size
 size_t retro_serialize_size(void)
 {
-    return sizeof(struct GB_State);
+    return GB_savestate_size(&gb);
 }
 
 bool retro_serialize(void *data, size_t size)
 {
-    return GB_savestate(&gb, (struct GB_State*)data);
+    return GB_serialize_state(&gb, data, size) != 0;
 }
 
 bool retro_unserialize(const void *data, size_t size)
 {
-    return GB_loadstate(&gb, (const struct GB_State*)data);
+    return GB_deserialize_state(&gb, data, size);
 }
 
 bool retro_load_game(const struct retro_game_info *game)
@@ -218,6 +246,8 @@ bool retro_load_game(const struct retro_game_info *game)
     memcpy(rom_data, game->data, game->size);
     rom_size = game->size;
 
+    check_variables();
+
     return GB_loadrom(&gb, rom_data, rom_size);
 }
 
@@ -231,6 +261,7 @@ void retro_unload_game(void)
 {
     free(framebuffers[0]); framebuffers[0] = NULL;
     free(framebuffers[1]); framebuffers[1] = NULL;
+    free(framebuffers[2]); framebuffers[2] = NULL;
 }
 
 // reset game
@@ -316,18 +347,60 @@ void retro_run(void)
         }
     }
 
-    GB_set_buttons(&gb, GB_BUTTON_A, buttons & RA_JOYPAD_A);
-    GB_set_buttons(&gb, GB_BUTTON_B, buttons & RA_JOYPAD_B);
-    GB_set_buttons(&gb, GB_BUTTON_UP, buttons & RA_JOYPAD_UP);
-    GB_set_buttons(&gb, GB_BUTTON_DOWN, buttons & RA_JOYPAD_DOWN);
-    GB_set_buttons(&gb, GB_BUTTON_LEFT, buttons & RA_JOYPAD_LEFT);
-    GB_set_buttons(&gb, GB_BUTTON_RIGHT, buttons & RA_JOYPAD_RIGHT);
-    GB_set_buttons(&gb, GB_BUTTON_START, buttons & RA_JOYPAD_START);
-    GB_set_buttons(&gb, GB_BUTTON_SELECT, buttons & RA_JOYPAD_SELECT);
+    uint8_t gb_buttons = 0;
+    if (buttons & RA_JOYPAD_A) { gb_buttons |= GB_BUTTON_A; }
+    if (buttons & RA_JOYPAD_B) { gb_buttons |= GB_BUTTON_B; }
+    if (buttons & RA_JOYPAD_UP) { gb_buttons |= GB_BUTTON_UP; }
+    if (buttons & RA_JOYPAD_DOWN) { gb_buttons |= GB_BUTTON_DOWN; }
+    if (buttons & RA_JOYPAD_LEFT) { gb_buttons |= GB_BUTTON_LEFT; }
+    if (buttons & RA_JOYPAD_RIGHT) { gb_buttons |= GB_BUTTON_RIGHT; }
+    if (buttons & RA_JOYPAD_START) { gb_buttons |= GB_BUTTON_START; }
+    if (buttons & RA_JOYPAD_SELECT) { gb_buttons |= GB_BUTTON_SELECT; }
+
+    // input is polled once per frame, so apply it at the start of the frame.
+    // this only raises the joypad interrupt on a new press.
+    GB_queue_buttons(&gb, 0, gb_buttons);
+
+    bool updated = false;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
+    {
+        check_variables();
+    }
+
+    if (runahead <= 0)
+    {
+        // run for a frame
+        GB_run(&gb, GB_FRAME_CPU_CYCLES);
+    }
+    else
+    {
+        // this is the real frame, its audio is kept, however its video is
+        // replaced with the frame from the furthest run-ahead.
+        present_frames = false;
+        GB_run(&gb, GB_FRAME_CPU_CYCLES);
 
-    // run for a frame
-    GB_run(&gb, GB_FRAME_CPU_CYCLES);
+        // turning audio off syncs the apu, so there's no pending audio in
+        // the state. the run-ahead frames then don't touch the audio output.
+        const unsigned freq = GB_get_apu_freq(&gb);
+        GB_set_apu_freq(&gb, 0);
+
+        if (GB_quicksave(&gb, &runahead_state))
+        {
+            for (int i = 0; i < runahead; i++)
+            {
+                present_frames = i == runahead - 1;
+                GB_run(&gb, GB_FRAME_CPU_CYCLES);
+            }
+
+            GB_loadstate(&gb, &runahead_state);
+        }
+
+        present_frames = true;
+        GB_set_apu_freq(&gb, freq);
+    }
 
-    // render
-    video_cb(framebuffers[framebuffer_index ^ 1], FRAMEBUFFER_W, FRAMEBUFFER_H, sizeof(uint16_t) * FRAMEBUFFER_W);
+    // render, if no new frame was finished (ie, lcd is off) then the
+    // last frame is shown again.
+    triple_buffer_acquire(&video);
+    video_cb(triple_buffer_front(&video), FRAMEBUFFER_W, FRAMEBUFFER_H, sizeof(uint16_t) * FRAMEBUFFER_W);
 }
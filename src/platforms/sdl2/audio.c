@@ -10,84 +10,74 @@
 
 static SDL_AudioDeviceID audio_device = 0;
 static SDL_AudioSpec audio_spec = {0};
-static SDL_AudioStream* audio_stream = NULL;
-static uint32_t elapsed_cycles = 0;
 static int volume = VOLUME;
 
+// max amount the core's output rate is adjusted by to keep the buffer
+// at the target fill level, 0.5% isn't noticeable in pitch.
+static const double MAX_RATE_DELTA = 0.005;
 
-static void mix_audio_u8(uint8_t* dst, const uint8_t* src, size_t len, int vol)
+// single producer (emu thread) single consumer (audio thread) ring.
+// read / write are free running frame counters, only the producer
+// writes [ring_write] and only the consumer writes [ring_read].
+static int16_t ring[RING_FRAMES * CHANNELS];
+static SDL_atomic_t ring_read = {0};
+static SDL_atomic_t ring_write = {0};
+
+
+static uint32_t ring_count(void)
 {
-    assert(AUDIO_FORMAT == AUDIO_U8);
-
-    Uint8 src_sample;
-    #define ADJUST_VOLUME_U8(s, v)  (s = (((s-128)*v)/SDL_MIX_MAXVOLUME)+128)
-    while (len--) {
-        src_sample = *src;
-        ADJUST_VOLUME_U8(src_sample, vol);
-        *dst = *dst + src_sample;
-        // *dst = mix8[*dst + src_sample];
-        ++dst;
-        ++src;
-    }
-    #undef ADJUST_VOLUME_U8
+    return (uint32_t)SDL_AtomicGet(&ring_write) - (uint32_t)SDL_AtomicGet(&ring_read);
 }
 
-static void core_auido_callback(void* user, struct GB_ApuCallbackData* data)
+// called on the emu thread whenever the core has filled a block
+static void core_audio_callback(void* user, const int16_t* samples, uint32_t frames)
 {
     UNUSED(user);
 
-    if (!audio_device || !audio_stream)
-    {
-        return;
-    }
+    const uint32_t write = SDL_AtomicGet(&ring_write);
+    const uint32_t space = RING_FRAMES - ring_count();
 
-    const uint8_t unmixed_audio[2] =
-    {
-        // | 0x80 because i think the range for u8 audio is 128-255
-        [0] = ((data->ch1[0] + data->ch2[0] + data->ch3[0] + data->ch4[0]) / 4) | 0x80,
-        [1] = ((data->ch1[1] + data->ch2[1] + data->ch3[1] + data->ch4[1]) / 4) | 0x80,
-    };
+    // if the ring is full then the audio thread isn't keeping up,
+    // drop the new samples as the consumer owns the read position.
+    frames = SDL_min(frames, space);
 
-    uint8_t mixed_audio[2] = {0};
-
-    // sdl impl for u8 is broken, the mix8 table makes zero sense
-    if (AUDIO_FORMAT == AUDIO_U8)
-    {
-        mix_audio_u8(mixed_audio, unmixed_audio, sizeof(mixed_audio), volume);
-    }
-    else
+    for (uint32_t i = 0; i < frames;)
     {
-        SDL_MixAudioFormat(mixed_audio, unmixed_audio, AUDIO_FORMAT, sizeof(mixed_audio), volume);
+        const uint32_t pos = (write + i) & (RING_FRAMES - 1);
+        const uint32_t count = SDL_min(frames - i, RING_FRAMES - pos);
+
+        SDL_memcpy(ring + pos * CHANNELS, samples + i * CHANNELS, count * CHANNELS * sizeof(int16_t));
+        i += count;
     }
 
-    SDL_AudioStreamPut(audio_stream, mixed_audio, sizeof(mixed_audio));
+    // publishes the samples to the audio thread
+    SDL_AtomicSet(&ring_write, write + frames);
 }
 
 static void sdl2_audio_callback(void* user, uint8_t* data, int len)
 {
-    emu_t* emu = SDL_static_cast(emu_t*, user);
+    UNUSED(user);
 
-    if (emu->rewinding || !emu->running || !mgb_has_rom() || get_menu_type() != MenuType_ROM)
+    int16_t* out = (void*)data;
+    const uint32_t read = SDL_AtomicGet(&ring_read);
+    const uint32_t wanted = (uint32_t)len / (CHANNELS * sizeof(int16_t));
+    const uint32_t frames = SDL_min(wanted, ring_count());
+
+    for (uint32_t i = 0; i < frames;)
     {
-        SDL_memset(data, audio_spec.silence, len);
-        return;
-    }
+        const uint32_t pos = (read + i) & (RING_FRAMES - 1);
+        const uint32_t count = SDL_min(frames - i, RING_FRAMES - pos);
 
-    const uint32_t tcyles = (GB_CPU_CYCLES / audio_spec.freq) * len;
+        SDL_memcpy(out + i * CHANNELS, ring + pos * CHANNELS, count * CHANNELS * sizeof(int16_t));
+        i += count;
+    }
 
-    audio_update_core_sample_rate(emu);
+    SDL_AtomicSet(&ring_read, read + frames);
 
-    lock_core();
-        while (SDL_AudioStreamAvailable(audio_stream) < len)
-        {
-            GB_run(&emu->gb, tcyles);
-            elapsed_cycles += tcyles;
-        }
-    unlock_core();
-
-    if (SDL_AudioStreamGet(audio_stream, data, len) == -1)
+    // underrun (or the emu isn't running), fill the rest with silence
+    if (frames < wanted)
     {
-        log_error("SDL_AudioStreamGet(): %s\n", SDL_GetError());
+        SDL_memset(out + frames * CHANNELS, audio_spec.silence, (wanted - frames) * CHANNELS * sizeof(int16_t));
     }
 }
 
@@ -102,7 +92,7 @@ bool audio_init(emu_t* emu)
     SDL_AudioSpec wanted_spec =
     {
         .freq = 0, // we set this later on
-        .format = AUDIO_U8,
+        .format = AUDIO_FORMAT,
         .channels = CHANNELS,
         .samples = SAMPLES,
         .callback = sdl2_audio_callback,
@@ -154,15 +144,9 @@ bool audio_init(emu_t* emu)
     log_info("[SDL-AUDIO] silence: %u\n", audio_spec.silence);
     log_info("\n");
 
-    const int core_sample_rate = audio_get_core_sample_rate(emu);
-
-    audio_stream = SDL_NewAudioStream(AUDIO_FORMAT, CHANNELS, core_sample_rate, audio_spec.format, audio_spec.channels, audio_spec.freq);
-    if (!audio_stream)
-    {
-        goto fail;
-    }
-
-    GB_set_apu_callback(&emu->gb, core_auido_callback, emu, core_sample_rate);
+    // small blocks so that the audio thread isn't waiting on a whole frame
+    GB_set_apu_block_callback(&emu->gb, core_audio_callback, emu, 0, BLOCK_FRAMES);
+    GB_set_apu_gain(&emu->gb, volume * GB_APU_GAIN_ONE / SDL_MIX_MAXVOLUME);
     audio_update_core_sample_rate(emu);
     SDL_PauseAudioDevice(audio_device, 0);
 
@@ -180,72 +164,34 @@ void audio_exit(void)
         SDL_CloseAudioDevice(audio_device);
         audio_device = 0;
     }
-
-    if (audio_stream)
-    {
-        SDL_FreeAudioStream(audio_stream);
-        audio_stream = NULL;
-    }
-}
-
-void audio_lock(void)
-{
-    SDL_LockAudioDevice(audio_device);
 }
 
-void audio_unlock(void)
+// dynamic rate control, the emu thread is paced by the system clock, which
+// drifts from the audio device clock. nudge the core's output rate so that
+// the ring stays around the target, rather than under / over running.
+void audio_update_rate_control(emu_t* emu)
 {
-    SDL_UnlockAudioDevice(audio_device);
-}
+    // the ring is filled a frame at a time, so keep a frame on top
+    const double target = audio_spec.samples * 2 + audio_spec.freq / 60;
+    const double fill = ring_count();
+    const double diff = SDL_max(-1.0, SDL_min((target - fill) / target, 1.0));
+    const double ratio = 1.0 + diff * MAX_RATE_DELTA;
 
-uint32_t audio_get_elapsed_cycles(void)
-{
-    const uint32_t cycles = elapsed_cycles;
-    elapsed_cycles = 0;
-    return cycles;
+    GB_set_apu_ratio(&emu->gb, (uint32_t)(ratio * GB_APU_RATIO_ONE));
 }
 
 int audio_get_core_sample_rate(const emu_t* emu)
 {
     UNUSED(emu);
 
-    // for some reason, when use sdl_stream, it stretches the audio too much
-    // if downsampling, meaning we end up with a lot more samples
-    // so we end up running the core less often, so it runs slow...
-    // for now, use the same sample rate the audio drive wants
-#if 0
-    const int freq = 1053360 * 2;
-#else
-    const int freq = audio_spec.freq * 2;
-#endif
-
-    return SDL_max(freq, audio_spec.freq);
+    // the core resamples to the device rate, see audio_update_rate_control()
+    return audio_spec.freq;
 }
 
 void audio_update_core_sample_rate(emu_t* emu)
 {
     int sample_rate = audio_get_core_sample_rate(emu);
 
-    // this was meant to reduce the sample rate slightly if we drifted
-    // too far forward.
-    // this didn't really work...
-    // a better option would be a combition of lowering the sample rate
-    // and skipping samples.
-
-    // if (audio_stream)
-    // {
-    //     const int half_frame_of_audio = (sample_rate / audio_spec.samples) * 30;
-
-    //     if (SDL_AudioStreamAvailable(audio_stream) > half_frame_of_audio)
-    //     {
-    //         // adjust sample rate so that we don't go too far forward!
-    //         const double max_delta = 0.010;
-    //         // const double max_delta = 0.005;
-    //         sample_rate -= (double)sample_rate * max_delta;
-    //         // log_info("[AUDIO] audio is too far ahead: %d, updating sample rate to: %d\n", SDL_AudioStreamAvailable(audio_stream), sample_rate);
-    //     }
-    // }
-
     // adjust the sample rate based on the playback speed
     if (emu->speed > 1)
     {
@@ -9,15 +9,20 @@ extern "C" {
 
 enum
 {
-    VOLUME = SDL_MIX_MAXVOLUME-20, // volume is not as loud using u8...
+    VOLUME = SDL_MIX_MAXVOLUME,
     CHANNELS = 2,
 #ifdef __SWITCH__
     SAMPLES = 2048,
 #else
     SAMPLES = 512,
 #endif
-    AUDIO_FORMAT = AUDIO_U8,
-    AUDIO_FLAGS = SDL_AUDIO_ALLOW_ANY_CHANGE,
+    // size of the ring between the emu and audio thread, must be a power of 2
+    RING_FRAMES = 8192,
+    // number of frames the core fills before pushing to the ring
+    BLOCK_FRAMES = 128,
+    AUDIO_FORMAT = AUDIO_S16SYS,
+    // the core outputs s16 stereo, so only let the freq and size change
+    AUDIO_FLAGS = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE,
 
     AUDIO_FREQ_11k = 11025,
     AUDIO_FREQ_22k = 22050,
@@ -31,18 +36,11 @@ bool audio_init(emu_t* emu);
 void audio_exit(void);
 
 SDL_AudioSpec audio_get_spec(void);
-// returns the number of cycles the apu has ticked the emulator for
-// resets the cycle counter on call, so save the result if needed
-// more than once!
-// you should either lock the audio or lock the core before
-// calling this!
-uint32_t audio_get_elapsed_cycles(void);
 
 int audio_get_core_sample_rate(const emu_t* emu);
 void audio_update_core_sample_rate(emu_t* emu);
-
-void audio_lock(void);
-void audio_unlock(void);
+// call this on the emu thread after running the core
+void audio_update_rate_control(emu_t* emu);
 
 #ifdef __cplusplus
 }
@@ -11,6 +11,7 @@
 #include <romloader.h>
 #include <util.h>
 #include <mgb.h>
+#include <triple_buffer.h>
 
 #include <gb.h>
 #include <stdio.h>
@@ -33,11 +34,22 @@
 
 static emu_t emu = {0};
 
-static void* pixels_buffers[2] = {0};
-static void* backbuffer = NULL;
-static void* frontbuffer = NULL;
+static void* pixels_buffers[3] = {0};
+// the emu thread renders into the back, the main thread presents the front
+static struct TripleBuffer video = {0};
+// only the frame from the furthest run-ahead frame is presented
+static bool present_frames = true;
+// static as it's large and is saved / loaded every frame when running ahead
+static struct GB_State runahead_state;
+// the buttons currently held down, these are queued with a cycle
+// timestamp so that the core applies them mid-frame.
+static uint8_t held_buttons = 0;
+// performance counter at the start of the last frame, used to time input.
+static Uint64 frame_start = 0;
 
 static SDL_mutex* mutex = NULL;
+static SDL_Thread* emu_thread = NULL;
+static SDL_atomic_t emu_thread_quit = {0};
 static SDL_Window* window = NULL;
 static SDL_Renderer* renderer = NULL;
 static SDL_Texture* texture = NULL;
@@ -221,18 +233,13 @@ static void core_vblank_callback(void* user)
 {
     UNUSED(user);
 
-    if (emu.speed > 0)
+    // keep drawing into the same back buffer
+    if (!present_frames)
     {
-        emu.gb.cycles_left_to_run = SDL_min(emu.gb.cycles_left_to_run, (GB_FRAME_CPU_CYCLES / 2) * emu.speed);
+        return;
     }
 
-    static int index = 0;
-
-    index ^= 1;
-    backbuffer = pixels_buffers[index];
-    frontbuffer = pixels_buffers[index ^ 1];
-    emu.pending_frame = true;
-    GB_set_pixels(&emu.gb, backbuffer, GB_SCREEN_WIDTH, pixel_format->BytesPerPixel);
+    GB_set_pixels(&emu.gb, triple_buffer_publish(&video), GB_SCREEN_WIDTH, pixel_format->BytesPerPixel);
 }
 
 static void sdl2_display_event(const SDL_DisplayEvent* e)
@@ -309,6 +316,10 @@ static void sdl2_ctrl_key_event(const SDL_KeyboardEvent* e, bool down)
                 mgb_load_rom_filedialog();
                 break;
 
+            case SDL_SCANCODE_R:
+                set_runahead((emu.runahead + 1) % (MAX_RUNAHEAD + 1));
+                break;
+
             default: break; // silence enum warning
         }
     }
@@ -488,10 +499,37 @@ static void sdl2_controller_axis_event(const SDL_ControllerAxisEvent* e)
     sdl2_generic_axis_event(e->value, e->axis);
 }
 
+// returns the cycle in the next frame that matches the time since the
+// start of the last frame, this keeps the spacing between inputs.
+static uint32_t get_input_cycle(void)
+{
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 elapsed = SDL_GetPerformanceCounter() - frame_start;
+
+    if (elapsed >= freq / (GB_CPU_CYCLES / GB_FRAME_CPU_CYCLES))
+    {
+        return GB_FRAME_CPU_CYCLES - 1;
+    }
+
+    return (uint32_t)(elapsed * GB_CPU_CYCLES / freq);
+}
+
 void set_emu_button(uint8_t gb_button, bool down)
 {
+    if (down)
+    {
+        held_buttons |= gb_button;
+    }
+    else
+    {
+        held_buttons &= ~gb_button;
+    }
+
     lock_core();
-        GB_set_buttons(&emu.gb, gb_button, down);
+        if (!GB_queue_buttons(&emu.gb, get_input_cycle(), held_buttons))
+        {
+            GB_set_buttons(&emu.gb, gb_button, down);
+        }
     unlock_core();
 }
 
@@ -716,6 +754,14 @@ void set_speed(int x)
     unlock_core();
 }
 
+void set_runahead(int frames)
+{
+    lock_core();
+        emu.runahead = SDL_max(0, SDL_min(frames, MAX_RUNAHEAD));
+        log_info("[RUNAHEAD] frames: %d\n", emu.runahead);
+    unlock_core();
+}
+
 int get_scale(int w, int h)
 {
     const int scale_w = w / WIDTH;
@@ -756,116 +802,190 @@ void toggle_fullscreen(void)
 void toggle_vsync(void)
 {
     emu.vsync ^= 1;
-    audio_lock();
-        audio_get_elapsed_cycles();
-    audio_unlock();
 #ifdef ANDROID
     const char* str = emu.vsync ? "Enabled Vsync: This may cause audio to go out of sync!" : "Disabled Vsync";
     SDL_AndroidShowToast(str, 0, -1, 0, 0);
 #endif
 }
 
-static void run(double delta)
+// the emu thread checks this while holding the core lock
+static bool can_run_core(void)
+{
+    return mgb_has_rom() && emu.running && !emu.rewinding && get_menu_type() == MenuType_ROM;
+}
+
+// runs a single frame, the core must be locked!
+static void run_frame(void)
 {
+    frame_start = SDL_GetPerformanceCounter();
+
     const time_t the_time = time(NULL);
     const struct tm* tm = localtime(&the_time);
 
-    if (!tm)
+    if (tm)
     {
-        log_error("failed to set rtc\n");
-        return;
+        const struct GB_Rtc rtc =
+        {
+            .S = tm->tm_sec,
+            .M = tm->tm_min,
+            .H = tm->tm_hour,
+            .DL = tm->tm_yday & 0xFF,
+            .DH = tm->tm_yday > 0xFF,
+        };
+
+        GB_set_rtc(&emu.gb, rtc);
     }
 
-    const struct GB_Rtc rtc =
-    {
-        .S = tm->tm_sec,
-        .M = tm->tm_min,
-        .H = tm->tm_hour,
-        .DL = tm->tm_yday & 0xFF,
-        .DH = tm->tm_yday > 0xFF,
-    };
+    // when fast forwarding, run multiple frames per tick
+    const uint32_t cycles = GB_FRAME_CPU_CYCLES * SDL_max(emu.speed, 1);
 
-    if (mgb_has_rom() && emu.running && get_menu_type() == MenuType_ROM)
+    if (emu.runahead <= 0)
     {
-        // this is unused atm.
-        if (emu.rewinding)
+        GB_run(&emu.gb, cycles);
+    }
+    else
+    {
+        // this is the real frame, its audio is kept, however its video is
+        // replaced with the frame from the furthest run-ahead.
+        present_frames = false;
+        GB_run(&emu.gb, cycles);
+
+        // turning audio off syncs the apu, so there's no pending audio in
+        // the state. the run-ahead frames then don't touch the audio output.
+        const unsigned freq = GB_get_apu_freq(&emu.gb);
+        GB_set_apu_freq(&emu.gb, 0);
+
+        if (GB_quicksave(&emu.gb, &runahead_state))
         {
-            lock_core();
-                const int speed = emu.speed > 1 ? emu.speed : 1;
+            for (int i = 0; i < emu.runahead; i++)
+            {
+                present_frames = i == emu.runahead - 1;
+                GB_run(&emu.gb, GB_FRAME_CPU_CYCLES);
+            }
 
-                for (int i = 0; i < speed; i++)
-                {
-                    if (mgb_rewind_pop_frame(frontbuffer, pixel_format->BytesPerPixel * HEIGHT * WIDTH))
-                    {
-                        emu.pending_frame = true;
-                    }
-                }
-            unlock_core();
+            GB_loadstate(&emu.gb, &runahead_state);
         }
-        else if (emu.vsync)
-        {
-            GB_set_rtc(&emu.gb, rtc);
 
-            // just in case something sends the main thread to sleep
-            // ie, filedialog, then cap the max delta to something reasonable!
-            // maybe keep track of deltas here to get an average?
-            delta = SDL_min(delta, 1.333333);
+        present_frames = true;
+        GB_set_apu_freq(&emu.gb, freq);
+    }
+
+    audio_update_rate_control(&emu);
+}
+
+// the core is run on its own thread, paced by the system clock.
+// audio is pushed to a ring which the audio thread reads from, so the
+// only time the core lock is taken elsewhere is for input and menu actions.
+static int emu_thread_func(void* user)
+{
+    UNUSED(user);
+
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 frame_period = freq / (GB_CPU_CYCLES / GB_FRAME_CPU_CYCLES);
+    Uint64 next = SDL_GetPerformanceCounter();
+    int save_counter = 0;
 
-            audio_lock();
-                uint32_t audio_cycles = audio_get_elapsed_cycles();
-                audio_cycles = SDL_min(audio_cycles, 1000);
-                double cycles = delta * (GB_FRAME_CPU_CYCLES - audio_cycles);
-            audio_unlock();
+    while (!SDL_AtomicGet(&emu_thread_quit))
+    {
+        const Uint64 now = SDL_GetPerformanceCounter();
+        Uint64 period = frame_period;
+        bool ran = false;
 
+        lock_core();
+            // slow motion, each frame takes longer
+            if (emu.speed < -1)
             {
-                static int counter = 0;
-                counter++;
-                if (counter == 60)
-                {
-                    // log_info("running for cycles: %d NORMAL: %d diff: %d\n", (int)cycles, GB_FRAME_CPU_CYCLES, (int)cycles - GB_FRAME_CPU_CYCLES);
-                    counter = 0;
-                }
+                period *= -emu.speed;
             }
 
-            if (emu.speed > 1)
+            if (!can_run_core())
             {
-                cycles *= emu.speed;
+                // paused, so start timing from now once resumed
+                next = now;
             }
-            else if (emu.speed < -1)
+            else if (now >= next)
             {
-                cycles /= emu.speed * -1;
+                run_frame();
+                ran = true;
+
+                // flush the save about once a second, if it changed
+                if (++save_counter >= 60)
+                {
+                    save_counter = 0;
+                    mgb_sync_save();
+                }
             }
+        unlock_core();
+
+        if (ran)
+        {
+            next += period;
 
-            if (emu.pending_frame && emu.speed > 0)
+            // we fell too far behind, ie, the thread was suspended,
+            // so don't try and catch up.
+            if (now > next + period * 4)
             {
-                cycles = SDL_min(cycles, (GB_FRAME_CPU_CYCLES - 2000) * emu.speed);
-                // update_game_texture();
+                next = now;
             }
+        }
+        else if (next > now)
+        {
+            SDL_Delay((Uint32)((next - now) * 1000 / freq));
+        }
+        else
+        {
+            SDL_Delay(1);
+        }
+    }
+
+    return 0;
+}
+
+static void run(double delta)
+{
+    UNUSED(delta);
+
+    if (mgb_has_rom() && emu.running && get_menu_type() == MenuType_ROM)
+    {
+        // this is unused atm.
+        if (emu.rewinding)
+        {
+            lock_core();
+                const int speed = emu.speed > 1 ? emu.speed : 1;
 
+                // the emu thread is paused whilst rewinding, so this
+                // thread is the producer for now.
+                for (int i = 0; i < speed; i++)
+                {
+                    if (mgb_rewind_pop_frame(triple_buffer_back(&video), pixel_format->BytesPerPixel * HEIGHT * WIDTH))
+                    {
+                        GB_set_pixels(&emu.gb, triple_buffer_publish(&video), GB_SCREEN_WIDTH, pixel_format->BytesPerPixel);
+                    }
+                }
+            unlock_core();
+        }
+    #ifdef EMSCRIPTEN
+        // no threads, so run the core here, once per animation frame
+        else
+        {
             lock_core();
-                GB_run(&emu.gb, cycles);
+                run_frame();
             unlock_core();
         }
+    #endif
     }
 }
 
 static void update_game_texture(void)
 {
-    if (mgb_has_rom())
+    // no lock needed, only upload if the core has finished a new frame
+    if (mgb_has_rom() && triple_buffer_acquire(&video))
     {
-        lock_core();
-            if (emu.pending_frame && !emu.rendered_frame)
-            {
-                void* pixels = NULL; int pitch = 0;
-
-                SDL_LockTexture(texture, NULL, &pixels, &pitch);
-                    SDL_memcpy(pixels, frontbuffer, pixel_format->BytesPerPixel * HEIGHT * WIDTH);
-                SDL_UnlockTexture(texture);
+        void* pixels = NULL; int pitch = 0;
 
-                emu.pending_frame = false;
-                emu.rendered_frame = true;
-            }
-        unlock_core();
+        SDL_LockTexture(texture, NULL, &pixels, &pitch);
+            SDL_memcpy(pixels, triple_buffer_front(&video), pixel_format->BytesPerPixel * HEIGHT * WIDTH);
+        SDL_UnlockTexture(texture);
     }
 }
 
@@ -879,7 +999,6 @@ static void render(void)
     {
         SDL_RenderCopy(renderer, texture, NULL, &rect);
     }
-    emu.rendered_frame = false;
 
     touch_render(renderer);
 
@@ -1099,6 +1218,13 @@ static void cleanup(void)
 {
     log_info("begin exit\n");
 
+    // stop the emu thread first as it uses everything below
+    if (emu_thread)
+    {
+        SDL_AtomicSet(&emu_thread_quit, 1);
+        SDL_WaitThread(emu_thread, NULL);
+    }
+
     // de-allocate sdl first, then core etc
     touch_exit();
     audio_exit();
@@ -1111,6 +1237,7 @@ static void cleanup(void)
     if (pixel_format)       { SDL_free(pixel_format); }
     if (pixels_buffers[0])  { SDL_free(pixels_buffers[0]); }
     if (pixels_buffers[1])  { SDL_free(pixels_buffers[1]); }
+    if (pixels_buffers[2])  { SDL_free(pixels_buffers[2]); }
 
     mgb_exit();
 
@@ -1157,7 +1284,7 @@ static void flushsave(void)
     counter = 0;
 
     lock_core();
-        mgb_save_save_file(NULL);
+        mgb_sync_save();
     unlock_core();
 }
 
@@ -1336,6 +1463,7 @@ int main(int argc, char* argv[])
     emu.scale = DEFAULT_SCALE;
     emu.speed = DEFAULT_SPEED;
     emu.vsync = DEFAULT_SYNC_VSYNC;
+    emu.runahead = DEFAULT_RUNAHEAD;
 
     if (!GB_init(&emu.gb))
     {
@@ -1424,7 +1552,8 @@ int main(int argc, char* argv[])
 
     pixels_buffers[0] = SDL_calloc(pixel_format->BytesPerPixel, HEIGHT * WIDTH);
     pixels_buffers[1] = SDL_calloc(pixel_format->BytesPerPixel, HEIGHT * WIDTH);
-    if (!pixels_buffers[0] || !pixels_buffers[1])
+    pixels_buffers[2] = SDL_calloc(pixel_format->BytesPerPixel, HEIGHT * WIDTH);
+    if (!pixels_buffers[0] || !pixels_buffers[1] || !pixels_buffers[2])
     {
         goto fail;
     }
@@ -1493,12 +1622,11 @@ int main(int argc, char* argv[])
     SDL_SetWindowMinimumSize(window, WIDTH, HEIGHT);
     on_resize(screenw, screenh);
 
-    backbuffer = pixels_buffers[0];
-    frontbuffer = pixels_buffers[1];
+    triple_buffer_init(&video, pixels_buffers[0], pixels_buffers[1], pixels_buffers[2]);
 
     GB_set_vblank_callback(&emu.gb, core_vblank_callback, &emu);
     GB_set_colour_callback(&emu.gb, core_colour_callback, &emu);
-    GB_set_pixels(&emu.gb, backbuffer, GB_SCREEN_WIDTH, pixel_format->BytesPerPixel);
+    GB_set_pixels(&emu.gb, triple_buffer_back(&video), GB_SCREEN_WIDTH, pixel_format->BytesPerPixel);
     GB_set_rtc_update_config(&emu.gb, GB_RTC_UPDATE_CONFIG_NONE);
 
     mgb_init(&emu.gb);
@@ -1594,6 +1722,9 @@ int main(int argc, char* argv[])
 #endif
 
 #if !defined(EMSCRIPTEN) && !defined(ANDROID)
+    // the game writes straight to the .sav, so a crash keeps the save
+    mgb_set_save_mmap(true);
+
     if (argc >= 2)
     {
         if (!mgb_load_rom_file(argv[1]))
@@ -1658,6 +1789,12 @@ int main(int argc, char* argv[])
     emscripten_set_main_loop(em_loop, 0, true);
 #endif
 
+    emu_thread = SDL_CreateThread(emu_thread_func, "emu", &emu);
+    if (!emu_thread)
+    {
+        goto fail;
+    }
+
     Uint64 start = SDL_GetPerformanceCounter();
     Uint64 now = 0;
 
@@ -20,6 +20,10 @@ enum
     DEFAULT_SYNC_VSYNC = 1,
     DEFAULT_SPEED = 1,
     DEFAULT_SCALE = 4,
+    DEFAULT_RUNAHEAD = 0,
+    // max number of frames to run-ahead, each frame costs a full extra frame
+    // of emulation, so keep this low.
+    MAX_RUNAHEAD = 4,
 
 #if 0
     RENDERER_FLAGS = SDL_RENDERER_ACCELERATED,
@@ -43,10 +47,10 @@ typedef struct
     enum MenuType menu_type;
     int speed;
     int scale;
+    // number of frames to run-ahead, 0 is disabled
+    int runahead;
     bool running;
     bool vsync;
-    bool pending_frame;
-    bool rendered_frame;
     bool rewinding;
 } emu_t;
 
@@ -71,6 +75,7 @@ void android_folder_picker(void);
 
 void scale_screen(int new_scale);
 void set_speed(int x);
+void set_runahead(int frames);
 int get_scale(int w, int h);
 
 void toggle_vsync(void);
@@ -0,0 +1,162 @@
+// round-trips delta states on dmg and gbc, see GB_serialize_state_delta().
+// the rom is built here, it keeps writing to wram and sram so every
+// delta has pages in it.
+#include <gb.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    ROM_SIZE = 0x8000,
+    SRAM_SIZE = 0x2000,
+    STATE_MAX = 1024 * 512,
+};
+
+static uint8_t rom[ROM_SIZE];
+static uint8_t sram[3][SRAM_SIZE];
+static uint8_t state_a[STATE_MAX];
+static uint8_t state_b[STATE_MAX];
+static uint8_t delta[2][STATE_MAX];
+static struct GB_Core cores[3];
+
+static void build_rom(uint8_t gbc_flag)
+{
+    static const uint8_t code[] =
+    {
+        0xF3,                   // di
+        0x3E, 0x0A,             // ld a, 0x0A
+        0xEA, 0x00, 0x00,       // ld (0x0000), a ; enable sram
+        0x21, 0x00, 0xC0,       // ld hl, 0xC000
+        0x11, 0x00, 0xA0,       // ld de, 0xA000
+        // loop:
+        0x3C,                   // inc a
+        0x22,                   // ld (hl+), a
+        0x12,                   // ld (de), a
+        0x13,                   // inc de
+        0x47,                   // ld b, a
+        0x7C,                   // ld a, h
+        0xFE, 0xD0,             // cp 0xD0
+        0x20, 0x02,             // jr nz, +2
+        0x26, 0xC0,             // ld h, 0xC0
+        0x7A,                   // ld a, d
+        0xFE, 0xC0,             // cp 0xC0
+        0x20, 0x02,             // jr nz, +2
+        0x16, 0xA0,             // ld d, 0xA0
+        0x78,                   // ld a, b
+        0x18, 0xEA,             // jr loop
+    };
+
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom + 0x100, (const uint8_t[]){ 0x00, 0xC3, 0x50, 0x01 }, 4);
+    memcpy(rom + 0x134, "DELTA", 5);
+    memcpy(rom + 0x150, code, sizeof(code));
+
+    rom[0x143] = gbc_flag;
+    rom[0x147] = 0x03; // mbc1 + ram + battery
+    rom[0x148] = 0x00; // 32KiB
+    rom[0x149] = 0x02; // 8KiB
+
+    uint8_t checksum = 0;
+    for (size_t i = 0x134; i < 0x14D; i++)
+    {
+        checksum = checksum - rom[i] - 1;
+    }
+    rom[0x14D] = checksum;
+}
+
+static bool load(struct GB_Core* gb, uint8_t* ram)
+{
+    memset(ram, 0, SRAM_SIZE);
+
+    return GB_init(gb) && (GB_set_sram(gb, ram, SRAM_SIZE), GB_loadrom(gb, rom, sizeof(rom)));
+}
+
+static void run_frames(struct GB_Core* gb, int frames)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        GB_run(gb, GB_FRAME_CPU_CYCLES);
+    }
+}
+
+// full states of both cores must be the same.
+static bool same_state(const struct GB_Core* a, const struct GB_Core* b)
+{
+    const size_t size_a = GB_serialize_state(a, state_a, sizeof(state_a));
+    const size_t size_b = GB_serialize_state(b, state_b, sizeof(state_b));
+
+    return size_a && size_a == size_b && !memcmp(state_a, state_b, size_a);
+}
+
+static bool is_sram_written(const uint8_t* ram)
+{
+    for (size_t i = 0; i < SRAM_SIZE; i++)
+    {
+        if (ram[i])
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s: FAILED: %s (line %d)\n", name, #cond, __LINE__); return false; } } while (0)
+
+static bool test_system(const char* name, uint8_t gbc_flag)
+{
+    struct GB_Core* src = &cores[0];
+    struct GB_Core* dst = &cores[1];
+
+    build_rom(gbc_flag);
+    CHECK(load(src, sram[0]));
+    CHECK(load(dst, sram[1]));
+    CHECK(GB_is_system_gbc(src) == (gbc_flag != 0));
+
+    // reset -> delta -> load, every page is dirty after a reset,
+    // including the ones that don't exist on this system / cart.
+    GB_reset(src);
+    run_frames(src, 1);
+
+    const size_t size0 = GB_serialize_state_delta(src, delta[0], sizeof(delta[0]));
+    CHECK(size0);
+    CHECK(GB_deserialize_state(dst, delta[0], size0));
+    CHECK(same_state(src, dst));
+
+    // delta -> delta -> load, onto a core that didn't see either
+    run_frames(src, 3);
+
+    const size_t size1 = GB_serialize_state_delta(src, delta[1], sizeof(delta[1]));
+    CHECK(size1);
+    CHECK(size1 < size0);
+
+    struct GB_Core* fresh = &cores[2];
+    CHECK(load(fresh, sram[2]));
+    CHECK(GB_deserialize_state(fresh, delta[0], size0));
+    CHECK(GB_deserialize_state(fresh, delta[1], size1));
+    CHECK(same_state(src, fresh));
+    CHECK(is_sram_written(sram[0]));
+    CHECK(!memcmp(sram[0], sram[2], SRAM_SIZE));
+
+    // and both keep running the same
+    run_frames(src, 2);
+    run_frames(fresh, 2);
+    CHECK(same_state(src, fresh));
+
+    printf("%s: ok\n", name);
+    return true;
+}
+
+int main(void)
+{
+    bool result = true;
+
+    result &= test_system("dmg", 0x00);
+#if GBC_ENABLE
+    result &= test_system("gbc", 0x80);
+#endif
+
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}